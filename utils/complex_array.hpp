@@ -0,0 +1,181 @@
+#ifndef XRD_COMPLEX_ARRAY_HPP
+#define XRD_COMPLEX_ARRAY_HPP
+
+#include <cmath>
+#include <type_traits>
+
+#include "math/vec.hpp"
+#include "types.hpp"
+
+namespace math {
+  /// Kernels on complex numbers stored as separate real and imaginary arrays of length n, in any floating point type.
+  /// The loops are written so that the compiler can vectorise them (no gsl_complex calls, no interleaved storage).
+  namespace soa {
+    /// re + i im = a * exp(i k phase)
+    template <typename T>
+    inline void assign_cis(std::type_identity_t<T> a, std::type_identity_t<T> k, const T* phase, T* re, T* im, sint_t n) noexcept {
+      T widest = 0;
+#pragma omp simd reduction(max : widest)
+      for(sint_t ii = 0; ii < n; ++ii) {
+        const T x = k * phase[ii];
+        T s, c;
+        vec::sincos(x, s, c);
+        re[ii] = a * c;
+        im[ii] = a * s;
+        widest = std::max(widest, std::abs(x));
+      }
+
+      /* phases past the range of the polynomial argument reduction are redone with libm */
+      if(widest > vec::reduction_limit<T>()) [[unlikely]]
+        for(sint_t ii = 0; ii < n; ++ii)
+          if(const T x = k * phase[ii]; std::abs(x) > vec::reduction_limit<T>()) {
+            re[ii] = a * std::cos(x);
+            im[ii] = a * std::sin(x);
+          }
+    }
+
+    /// re + i im += a * exp(i k phase)
+    template <typename T>
+    inline void accumulate_cis(std::type_identity_t<T> a, std::type_identity_t<T> k, const T* phase, T* re, T* im, sint_t n) noexcept {
+      T widest = 0;
+#pragma omp simd reduction(max : widest)
+      for(sint_t ii = 0; ii < n; ++ii) {
+        const T x = k * phase[ii];
+        T s, c;
+        vec::sincos(x, s, c);
+        re[ii] += a * c;
+        im[ii] += a * s;
+        widest = std::max(widest, std::abs(x));
+      }
+
+      /* as in assign_cis(), replacing the polynomial terms that were added */
+      if(widest > vec::reduction_limit<T>()) [[unlikely]]
+        for(sint_t ii = 0; ii < n; ++ii)
+          if(const T x = k * phase[ii]; std::abs(x) > vec::reduction_limit<T>()) {
+            T s, c;
+            vec::sincos(x, s, c);
+            re[ii] += a * (std::cos(x) - c);
+            im[ii] += a * (std::sin(x) - s);
+          }
+    }
+
+    /// re + i im += (x_re + i x_im) * (y_re + i y_im)
+    template <typename T>
+    inline void multiply_accumulate(const T* x_re, const T* x_im, const T* y_re, const T* y_im, T* re, T* im, sint_t n) noexcept {
+#pragma omp simd
+      for(sint_t ii = 0; ii < n; ++ii) {
+        re[ii] += x_re[ii] * y_re[ii] - x_im[ii] * y_im[ii];
+        im[ii] += x_re[ii] * y_im[ii] + x_im[ii] * y_re[ii];
+      }
+    }
+
+    /// sum_i |re_i + i im_i|^2
+    template <typename T>
+    [[nodiscard]] inline T squared_norm_sum(const T* re, const T* im, sint_t n) noexcept {
+      T sum = 0;
+#pragma omp simd reduction(+ : sum)
+      for(sint_t ii = 0; ii < n; ++ii)
+        sum += re[ii] * re[ii] + im[ii] * im[ii];
+      return sum;
+    }
+
+    /// sum_i w_i |re_i + i im_i|^2
+    template <typename T>
+    [[nodiscard]] inline T squared_norm_dot(const T* w, const T* re, const T* im, sint_t n) noexcept {
+      T sum = 0;
+#pragma omp simd reduction(+ : sum)
+      for(sint_t ii = 0; ii < n; ++ii)
+        sum += w[ii] * (re[ii] * re[ii] + im[ii] * im[ii]);
+      return sum;
+    }
+  }    // namespace soa
+
+  /// Dynamic length complex array in structure-of-arrays layout, the bulk counterpart of cdata_t. The real and
+  /// imaginary parts are exposed as Eigen maps, and the soa kernels work on them directly.
+  class complex_array {
+   public:
+    complex_array() = default;
+    explicit complex_array(sint_t n) : m_Re(n), m_Im(n) {}
+    explicit complex_array(const cdata_t& z) : m_Re(z.size()), m_Im(z.size()) {
+      for(sint_t ii = 0; ii < z.size(); ++ii) {
+        m_Re(ii) = z(ii).re();
+        m_Im(ii) = z(ii).im();
+      }
+    }
+
+    [[nodiscard]] static complex_array zero(sint_t n) {
+      complex_array z(n);
+      z.set_zero();
+      return z;
+    }
+
+    [[nodiscard]] inline sint_t size() const noexcept {
+      return m_Re.size();
+    }
+    inline void resize(sint_t n) {
+      m_Re.resize(n);
+      m_Im.resize(n);
+    }
+    inline void set_zero() noexcept {
+      m_Re.setZero();
+      m_Im.setZero();
+    }
+
+    [[nodiscard]] inline rdata_span_t re() noexcept {
+      return {m_Re.data(), m_Re.size()};
+    }
+    [[nodiscard]] inline rdata_view_t re() const noexcept {
+      return {m_Re.data(), m_Re.size()};
+    }
+    [[nodiscard]] inline rdata_span_t im() noexcept {
+      return {m_Im.data(), m_Im.size()};
+    }
+    [[nodiscard]] inline rdata_view_t im() const noexcept {
+      return {m_Im.data(), m_Im.size()};
+    }
+
+    [[nodiscard]] inline cplx_t operator()(sint_t ii) const noexcept {
+      return {static_cast<double>(m_Re(ii)), static_cast<double>(m_Im(ii))};
+    }
+
+    [[nodiscard]] cdata_t to_cdata() const {
+      cdata_t z(size());
+      for(sint_t ii = 0; ii < size(); ++ii)
+        z(ii) = (*this)(ii);
+      return z;
+    }
+
+    /// this = a * exp(i k phase)
+    inline void assign_cis(real_t a, real_t k, const rdata_t& phase) {
+      resize(phase.size());
+      soa::assign_cis(a, k, phase.data(), m_Re.data(), m_Im.data(), size());
+    }
+    /// this += a * exp(i k phase); phase must have the size of this array.
+    inline void accumulate_cis(real_t a, real_t k, const rdata_t& phase) noexcept {
+      soa::accumulate_cis(a, k, phase.data(), m_Re.data(), m_Im.data(), size());
+    }
+    /// this += x * y (element-wise); x and y must have the size of this array.
+    inline void multiply_accumulate(const complex_array& x, const complex_array& y) noexcept {
+      soa::multiply_accumulate(x.m_Re.data(), x.m_Im.data(), y.m_Re.data(), y.m_Im.data(), m_Re.data(), m_Im.data(), size());
+    }
+
+    /// Element-wise |z|^2.
+    [[nodiscard]] inline rdata_t squared_norm() const {
+      return m_Re.square() + m_Im.square();
+    }
+    /// sum_i |z_i|^2
+    [[nodiscard]] inline real_t squared_norm_sum() const noexcept {
+      return soa::squared_norm_sum(m_Re.data(), m_Im.data(), size());
+    }
+    /// sum_i w_i |z_i|^2
+    [[nodiscard]] inline real_t squared_norm_dot(const rdata_t& w) const noexcept {
+      return soa::squared_norm_dot(w.data(), m_Re.data(), m_Im.data(), size());
+    }
+
+   private:
+    rdata_t m_Re;
+    rdata_t m_Im;
+  };
+}    // namespace math
+
+#endif    //XRD_COMPLEX_ARRAY_HPP
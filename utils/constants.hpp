@@ -17,6 +17,12 @@ constexpr real_t C_SQRT2 = M_SQRT2l;
 constexpr real_t C_SQRT2 = 1.414213562373095048801688724209698078L;
 #endif
 
+#if defined(M_LN2l)
+constexpr real_t C_LN2 = M_LN2l;
+#else
+constexpr real_t C_LN2 = 0.693147180559945309417232121458176568L;
+#endif
+
 namespace SI {
   constexpr real_t C_EV = 1.60217662e-19L;
 
@@ -1,5 +1,56 @@
 #include "convolution.hpp"
 
+#include <algorithm>
+
+#include "simd.hpp"
+#include "vec.hpp"
+
+namespace {
+  /* out[0..size) = kernel (2n + 1 taps) applied to signal[0..size), compiled once per instruction set */
+  using convolution_fn = void (*)(const real_t* kernel, sint_t n, const real_t* signal, sint_t size, real_t* out) noexcept;
+
+  XRD_SIMD_INLINE void convolve(const real_t* kernel, sint_t n, const real_t* signal, sint_t size, real_t* out) noexcept {
+    /* interior points [n, size - n) see the whole kernel; the loop over taps is outside so that the loop over
+     * points vectorises */
+    const sint_t l_bound = std::min(n, size), r_bound = std::max(l_bound, size - n);
+    for(sint_t ii = l_bound; ii < r_bound; ++ii)
+      out[ii] = 0;
+    for(sint_t tt = 0; tt <= 2 * n; ++tt) {
+      const real_t k = kernel[tt];
+      const real_t* s = signal + tt - n;
+#pragma omp simd
+      for(sint_t ii = l_bound; ii < r_bound; ++ii)
+        out[ii] += k * s[ii];
+    }
+
+    /* edge points only see part of the kernel, which is renormalised */
+    auto fn_edge = [kernel, n, signal, size, out](sint_t ii) noexcept {
+      real_t sum = 0, weight = 0;
+      for(sint_t jj = std::max<sint_t>(0, ii - n); jj < std::min(size, ii + n + 1); ++jj) {
+        sum += kernel[jj - ii + n] * signal[jj];
+        weight += kernel[jj - ii + n];
+      }
+      out[ii] = sum / weight;
+    };
+    for(sint_t ii = 0; ii < l_bound; ++ii)
+      fn_edge(ii);
+    for(sint_t ii = r_bound; ii < size; ++ii)
+      fn_edge(ii);
+  }
+
+  void convolve_baseline(const real_t* kernel, sint_t n, const real_t* signal, sint_t size, real_t* out) noexcept {
+    convolve(kernel, n, signal, size, out);
+  }
+  XRD_SIMD_TARGET_AVX2 void convolve_avx2(const real_t* kernel, sint_t n, const real_t* signal, sint_t size, real_t* out) noexcept {
+    convolve(kernel, n, signal, size, out);
+  }
+  XRD_SIMD_TARGET_AVX512 void convolve_avx512(const real_t* kernel, sint_t n, const real_t* signal, sint_t size, real_t* out) noexcept {
+    convolve(kernel, n, signal, size, out);
+  }
+
+  constexpr std::array<convolution_fn, simd::k_IsaCount> k_ConvolutionKernels{&convolve_baseline, &convolve_avx2, &convolve_avx512};
+}    // namespace
+
 math::convolution_kernel_1d math::convolution_kernel_1d::boxcar(sint_t n) noexcept {
   convolution_kernel_1d ck(n);
   ck.modify([&ck](const sint_t ii) -> real_t { return 1 / real_t(ck.size()); });
@@ -8,36 +59,12 @@ math::convolution_kernel_1d math::convolution_kernel_1d::boxcar(sint_t n) noexce
 
 math::convolution_kernel_1d math::convolution_kernel_1d::gaussian(real_t sigma) noexcept {
   convolution_kernel_1d ck(std::ceil(3 * sigma));
-  ck.modify([c1 = 1 / std::sqrt(2 * C_PI * sigma * sigma), c2 = 1 / (2 * sigma * sigma)](const sint_t ii) -> real_t { return c1 * std::exp(-c2 * ii * ii); });
+  ck.modify([c1 = 1 / std::sqrt(2 * C_PI * sigma * sigma), c2 = 1 / (2 * sigma * sigma)](const sint_t ii) -> real_t { return c1 * vec::exp(-c2 * ii * ii); });
   return ck;
 }
 
 rdata_t math::convolution_kernel_1d::apply(std::span<const real_t> signal) const {
   rdata_t buf(signal.size());
-  {
-    auto blurred = std::span(buf);
-    auto fn_get_partial_block = [this, signal](const sint_t i) -> std::span<const real_t> {
-      const sint_t l_bound = std::max<sint_t>(0, i - m_N), u_bound = std::min<sint_t>(signal.size(), i + m_N + 1);
-      return signal.subspan(l_bound, u_bound - l_bound);
-    };
-    auto fn_get_full_block = [this, signal](const sint_t i) -> std::span<const real_t> {
-      return signal.subspan(i - m_N, 2 * m_N + 1);
-    };
-
-    if(static_cast<sint_t>(blurred.size()) >= (2 * m_N + 1)) {
-      auto l_bound = m_N;
-      auto r_bound = static_cast<sint_t>(blurred.size()) - m_N - 1;
-
-      for(sint_t ii = 0; ii < l_bound; ++ii)
-        blurred[ii] = apply_partial(fn_get_partial_block(ii), ii);
-      for(sint_t ii = l_bound; ii < r_bound; ++ii)
-        blurred[ii] = apply_full(fn_get_full_block(ii));
-      for(sint_t ii = r_bound; ii < static_cast<sint_t>(blurred.size()); ++ii)
-        blurred[ii] = apply_partial(fn_get_partial_block(ii), ii - r_bound);
-    } else {
-      for(sint_t ii = 0; ii < static_cast<sint_t>(blurred.size()); ++ii)
-        blurred[ii] = apply_partial(fn_get_partial_block(ii), ii);
-    }
-  }
+  simd::dispatch(k_ConvolutionKernels)(m_Kernel.data(), m_N, signal.data(), signal.size(), buf.data());
   return buf;
 }
@@ -0,0 +1,66 @@
+#include "debye.hpp"
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include "constants.hpp"
+
+namespace {
+  /* B_2k / ((2k + 1) (2k)!) for k = 1, ..., 14; the first omitted term is below 1e-16 for |x| < 2 */
+  constexpr std::array<real_t, 14> k_SeriesCoefficients = {
+    2.77777777777777777778e-2L,  -2.77777777777777777778e-4L, 4.72411186696900982615e-6L,   -9.18577307466196355085e-8L, 1.89788699889709990720e-9L,
+    -4.06476164514422552681e-11L, 8.92169102045645255522e-13L, -1.99392958607210756872e-14L, 4.51898002961991819165e-16L, -1.03565176121812470145e-17L,
+    2.39521862102618674574e-19L,  -5.58178587432500933628e-21L, 1.30915075541832128581e-22L, -3.08741980242674029324e-24L};
+
+  constexpr real_t k_SeriesLimit = 2;
+  /* beyond this the exponential sum is below 1e-16 of pi^2/6 (and e^(-x) underflows from about 745 on) */
+  constexpr real_t k_AsymptoticLimit = 40;
+
+  real_t d1_series(real_t x) noexcept {
+    const real_t x2 = x * x;
+
+    /* Horner in x^2 */
+    real_t sum = 0;
+    for(auto it = k_SeriesCoefficients.rbegin(); it != k_SeriesCoefficients.rend(); ++it)
+      sum = sum * x2 + *it;
+
+    return 1 - x / 4 + x2 * sum;
+  }
+
+  real_t d1_exponential(real_t x) noexcept {
+    const real_t q = std::exp(-x);
+
+    real_t sum = 0;
+    real_t qk = q;
+    for(sint_t k = 1;; ++k, qk *= q) {
+      const real_t term = qk * (x / k + real_t(1) / (k * k));
+      sum += term;
+      /* negated, so that a NaN term also ends the loop */
+      if(!(term >= std::numeric_limits<real_t>::epsilon() * sum))
+        break;
+    }
+
+    return (C_PI * C_PI / 6 - sum) / x;
+  }
+}    // namespace
+
+real_t math::debye::d1(real_t x) noexcept {
+  if(x < k_SeriesLimit)
+    return d1_series(x);
+  if(x > k_AsymptoticLimit)
+    return C_PI * C_PI / (6 * x);
+  return d1_exponential(x);
+}
+
+void math::debye::d1(std::span<const real_t> x, std::span<real_t> out) {
+  if(x.size() != out.size())
+    throw std::invalid_argument(fmt::format("shape mismatch: x size ({}) != out size ({})", x.size(), out.size()));
+
+#pragma omp parallel for default(none) shared(x, out)
+  for(size_t ii = 0; ii < x.size(); ++ii)
+    out[ii] = d1(x[ii]);
+}
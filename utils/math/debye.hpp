@@ -0,0 +1,19 @@
+#ifndef XRD_DEBYE_HPP
+#define XRD_DEBYE_HPP
+
+#include <span>
+
+#include "types.hpp"
+
+namespace math::debye {
+  /// First Debye function D_1(x) = (1/x) int_0^x t / (e^t - 1) dt, with D_1(0) = 1.
+  /// Uses the Bernoulli series for |x| < 2 and the exponential series pi^2/6 - sum_k e^(-kx) (x/k + 1/k^2) for larger x,
+  /// both accurate to a few ulp in double precision; past x = 40 the sum is negligible and D_1(x) = pi^2 / (6x), which
+  /// also covers x = inf (T = 0). Only defined for x > -2 pi.
+  real_t d1(real_t x) noexcept;
+
+  /// Batch version of d1(), e.g. for sweeps over the temperature. x and out must have the same size.
+  void d1(std::span<const real_t> x, std::span<real_t> out);
+}    // namespace math::debye
+
+#endif    //XRD_DEBYE_HPP
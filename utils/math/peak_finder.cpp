@@ -1,5 +1,6 @@
 #include "peak_finder.hpp"
 
+#include <algorithm>
 #include <array>
 
 #include <allocator.hpp>
@@ -221,3 +222,18 @@ stl::vector<sint_t> math::find_peak_indices(std::span<const real_t> x0, real_t r
 
   return peak_indices;
 }
+
+real_t math::refine_peak_position(std::span<const real_t> x, std::span<const real_t> y, sint_t index) noexcept {
+  if(index <= 0 || index + 1 >= static_cast<sint_t>(std::min(x.size(), y.size())))
+    return x[index];
+
+  /* p(t) = y0 + d0 (t - x0) + c (t - x0)(t - x1), with p'(t) = 0 at t = (x0 + x1)/2 - d0/(2c) */
+  const real_t x0 = x[index - 1], x1 = x[index], x2 = x[index + 1];
+  const real_t d0 = (y[index] - y[index - 1]) / (x1 - x0);
+  const real_t d1 = (y[index + 1] - y[index]) / (x2 - x1);
+  const real_t c = (d1 - d0) / (x2 - x0);
+  if(c == 0)
+    return x1;
+
+  return std::clamp((x0 + x1) / 2 - d0 / (2 * c), x0, x2);
+}
@@ -26,6 +26,10 @@ namespace math {
 
     return peaks;
   }
+
+  /// Position of the extremum of the parabola through the sample at index and its two neighbours, i.e. the peak
+  /// between the grid points x. Returns x[index] at the ends of the grid and where the three samples are collinear.
+  real_t refine_peak_position(std::span<const real_t> x, std::span<const real_t> y, sint_t index) noexcept;
 }    // namespace math
 
 #endif    //XRD_PEAK_FINDER_HPP
@@ -0,0 +1,11 @@
+#include "random.hpp"
+
+#include <random>
+
+std::uint64_t math::rand::default_seed() {
+  static const std::uint64_t s_Seed = [] {
+    std::random_device rd;
+    return (std::uint64_t(rd()) << 32) | rd();
+  }();
+  return s_Seed;
+}
@@ -0,0 +1,100 @@
+#ifndef XRD_RANDOM_HPP
+#define XRD_RANDOM_HPP
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+#include "types.hpp"
+
+namespace math::rand {
+  /// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC11).
+  /// The output is a pure function of the key and the counter, so any sample can be drawn independently of the others,
+  /// in any order and on any thread.
+  class philox4x32 {
+   public:
+    using counter_type = std::array<std::uint32_t, 4>;
+    using result_type = std::array<std::uint32_t, 4>;
+
+    constexpr explicit philox4x32(std::uint64_t key) noexcept : m_Key{static_cast<std::uint32_t>(key), static_cast<std::uint32_t>(key >> 32)} {}
+
+    [[nodiscard]] constexpr result_type operator()(counter_type c) const noexcept {
+      std::array<std::uint32_t, 2> k = m_Key;
+      for(int r = 0; r < 10; ++r) {
+        const std::uint64_t p0 = std::uint64_t(k_M0) * c[0];
+        const std::uint64_t p1 = std::uint64_t(k_M1) * c[2];
+        c = {static_cast<std::uint32_t>(p1 >> 32) ^ c[1] ^ k[0], static_cast<std::uint32_t>(p1), static_cast<std::uint32_t>(p0 >> 32) ^ c[3] ^ k[1],
+             static_cast<std::uint32_t>(p0)};
+        k[0] += k_W0;
+        k[1] += k_W1;
+      }
+      return c;
+    }
+
+    /// Two uniform numbers in [0, 1) for sample index of the given stream.
+    [[nodiscard]] constexpr std::array<real_t, 2> uniform2(std::uint64_t index, std::uint32_t stream = 0) const noexcept {
+      const result_type r = (*this)({static_cast<std::uint32_t>(index), static_cast<std::uint32_t>(index >> 32), stream, 0});
+      return {to_unit(r[0], r[1]), to_unit(r[2], r[3])};
+    }
+
+    [[nodiscard]] static constexpr real_t to_unit(std::uint32_t hi, std::uint32_t lo) noexcept {
+      return static_cast<real_t>(((std::uint64_t(hi) << 32) | lo) >> 11) * 0x1p-53;
+    }
+
+   private:
+    static constexpr std::uint32_t k_M0 = 0xD2511F53u;
+    static constexpr std::uint32_t k_M1 = 0xCD9E8D57u;
+    static constexpr std::uint32_t k_W0 = 0x9E3779B9u;
+    static constexpr std::uint32_t k_W1 = 0xBB67AE85u;
+
+    std::array<std::uint32_t, 2> m_Key;
+  };
+
+  /// Sequential view of one stream of a philox4x32 generator, usable wherever a standard uniform random bit generator is
+  /// expected (std::shuffle, distributions, ...).
+  class philox_engine {
+   public:
+    using result_type = std::uint64_t;
+
+    constexpr explicit philox_engine(std::uint64_t key, std::uint32_t stream = 0) noexcept : m_Philox{key}, m_Stream{stream} {}
+
+    static constexpr result_type min() noexcept {
+      return 0;
+    }
+    static constexpr result_type max() noexcept {
+      return std::numeric_limits<result_type>::max();
+    }
+
+    constexpr result_type operator()() noexcept {
+      if(m_Index == 2) {
+        m_Block = m_Philox({static_cast<std::uint32_t>(m_Counter), static_cast<std::uint32_t>(m_Counter >> 32), m_Stream, 1});
+        ++m_Counter;
+        m_Index = 0;
+      }
+      const result_type r = (std::uint64_t(m_Block[2 * m_Index]) << 32) | m_Block[2 * m_Index + 1];
+      ++m_Index;
+      return r;
+    }
+
+   private:
+    philox4x32 m_Philox;
+    std::uint32_t m_Stream;
+
+    std::uint64_t m_Counter = 0;
+    philox4x32::result_type m_Block{};
+    int m_Index = 2;
+  };
+
+  /// Derives an independent key from a seed and a stream number (SplitMix64 finaliser).
+  [[nodiscard]] constexpr std::uint64_t derive_key(std::uint64_t seed, std::uint64_t stream) noexcept {
+    std::uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  /// Seed used when none is given explicitly: drawn once per process from std::random_device.
+  std::uint64_t default_seed();
+}    // namespace math::rand
+
+#endif    //XRD_RANDOM_HPP
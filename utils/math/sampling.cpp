@@ -0,0 +1,170 @@
+#include "sampling.hpp"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+#include "random.hpp"
+
+namespace {
+  constexpr real_t k_TwoPow32 = 4294967296.0;
+
+  /* largest value below one, so that no point lands on the upper edge of the square */
+  constexpr real_t k_OneMinusEps = 1 - std::numeric_limits<real_t>::epsilon() / 2;
+
+  /* philox streams: per-point draws and the per-set randomisation are kept apart */
+  constexpr std::uint32_t k_PointStream = 0;
+  constexpr std::uint32_t k_SetStream = 1;
+
+  inline real_t to_unit(std::uint32_t x) noexcept {
+    return std::min<real_t>(x / k_TwoPow32, k_OneMinusEps);
+  }
+
+  inline std::uint32_t reverse_bits(std::uint32_t x) noexcept {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+  }
+
+  /* Owen (nested uniform) scrambling through a hash in which every bit only depends on the bits below it, applied to the
+   * bit reversed value so that each digit is permuted depending on the more significant ones (Laine-Karras; Burley 2020) */
+  inline std::uint32_t owen_scramble(std::uint32_t x, std::uint32_t seed) noexcept {
+    x = reverse_bits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverse_bits(x);
+  }
+
+  /* direction numbers of the first two Sobol dimensions: the van der Corput sequence and the one generated by the
+   * primitive polynomial x + 1 (m_k = 2 m_{k-1} ^ m_{k-1}, m_1 = 1) */
+  constexpr std::array<std::array<std::uint32_t, 32>, 2> k_SobolDirections = [] {
+    std::array<std::array<std::uint32_t, 32>, 2> v{};
+    std::uint32_t m = 1;
+    for(int k = 0; k < 32; ++k) {
+      v[0][k] = std::uint32_t(1) << (31 - k);
+      v[1][k] = m << (31 - k);
+      m = (m << 1) ^ m;
+    }
+    return v;
+  }();
+
+  inline std::uint32_t sobol_point(std::uint32_t index, sint_t dim) noexcept {
+    std::uint32_t x = 0;
+    for(int k = 0; index != 0; index >>= 1, ++k)
+      if(index & 1)
+        x ^= k_SobolDirections[dim][k];
+    return x;
+  }
+
+  inline real_t radical_inverse(uint_t index, uint_t base) noexcept {
+    const real_t inv_base = real_t(1) / base;
+    real_t inv = inv_base, result = 0;
+    while(index > 0) {
+      result += (index % base) * inv;
+      index /= base;
+      inv *= inv_base;
+    }
+    return result;
+  }
+}    // namespace
+
+rmatrix_t<2, n_dynamic> math::sampling::unit_square(math::sampling::method m, uint_t count, std::uint64_t key) {
+  switch(m) {
+    default:
+    case method::e_Random:
+      return random(count, key);
+    case method::e_Sobol:
+      return sobol(count, key);
+    case method::e_Halton:
+      return halton(count, key);
+    case method::e_Stratified:
+      return stratified(count, key);
+    case method::e_Antithetic:
+      return antithetic(count, key);
+  }
+}
+
+rmatrix_t<2, n_dynamic> math::sampling::random(uint_t count, std::uint64_t key) {
+  const rand::philox4x32 gen{key};
+
+  rmatrix_t<2, n_dynamic> points(2, count);
+#pragma omp parallel for default(none) shared(points, gen, k_PointStream)
+  for(sint_t ii = 0; ii < points.cols(); ++ii) {
+    const auto u = gen.uniform2(ii, k_PointStream);
+    points(0, ii) = u[0];
+    points(1, ii) = u[1];
+  }
+  return points;
+}
+
+rmatrix_t<2, n_dynamic> math::sampling::sobol(uint_t count, std::uint64_t key) {
+  const auto seeds = rand::philox4x32{key}({0, 0, k_SetStream, 0});
+
+  /* points are generated directly from their index (not in Gray code order), which gives the same set for powers of two */
+  rmatrix_t<2, n_dynamic> points(2, count);
+#pragma omp parallel for default(none) shared(points, seeds)
+  for(sint_t ii = 0; ii < points.cols(); ++ii) {
+    points(0, ii) = to_unit(owen_scramble(sobol_point(ii, 0), seeds[0]));
+    points(1, ii) = to_unit(owen_scramble(sobol_point(ii, 1), seeds[1]));
+  }
+  return points;
+}
+
+rmatrix_t<2, n_dynamic> math::sampling::halton(uint_t count, std::uint64_t key) {
+  const auto shifts = rand::philox4x32{key}.uniform2(0, k_SetStream);
+
+  rmatrix_t<2, n_dynamic> points(2, count);
+#pragma omp parallel for default(none) shared(points, shifts, k_OneMinusEps)
+  for(sint_t ii = 0; ii < points.cols(); ++ii) {
+    /* the first point of the unshifted sequence is the origin, so start at index 1 */
+    for(sint_t dd = 0; dd < 2; ++dd) {
+      const real_t u = radical_inverse(ii + 1, dd == 0 ? 2 : 3) + shifts[dd];
+      points(dd, ii) = std::min(u - std::floor(u), k_OneMinusEps);
+    }
+  }
+  return points;
+}
+
+rmatrix_t<2, n_dynamic> math::sampling::stratified(uint_t count, std::uint64_t key) {
+  const rand::philox4x32 gen{key};
+
+  std::array<stl::vector<uint_t>, 2> strata;
+  for(sint_t dd = 0; dd < 2; ++dd) {
+    rand::philox_engine engine{key, static_cast<std::uint32_t>(k_SetStream + dd)};
+    strata[dd].resize(count);
+    std::iota(strata[dd].begin(), strata[dd].end(), uint_t(0));
+    std::shuffle(strata[dd].begin(), strata[dd].end(), engine);
+  }
+
+  rmatrix_t<2, n_dynamic> points(2, count);
+#pragma omp parallel for default(none) shared(points, gen, strata, count, k_PointStream, k_OneMinusEps)
+  for(sint_t ii = 0; ii < points.cols(); ++ii) {
+    const auto u = gen.uniform2(ii, k_PointStream);
+    for(sint_t dd = 0; dd < 2; ++dd)
+      points(dd, ii) = std::min((strata[dd][ii] + u[dd]) / count, k_OneMinusEps);
+  }
+  return points;
+}
+
+rmatrix_t<2, n_dynamic> math::sampling::antithetic(uint_t count, std::uint64_t key) {
+  const rand::philox4x32 gen{key};
+
+  rmatrix_t<2, n_dynamic> points(2, count);
+#pragma omp parallel for default(none) shared(points, gen, k_PointStream, k_OneMinusEps)
+  for(sint_t ii = 0; ii < points.cols(); ++ii) {
+    const auto u = gen.uniform2(ii / 2, k_PointStream);
+    if(ii % 2 == 0) {
+      points(0, ii) = u[0];
+      points(1, ii) = u[1];
+    } else {
+      points(0, ii) = std::min(1 - u[0], k_OneMinusEps);
+      points(1, ii) = std::min(1 - u[1], k_OneMinusEps);
+    }
+  }
+  return points;
+}
@@ -0,0 +1,30 @@
+#ifndef XRD_SAMPLING_HPP
+#define XRD_SAMPLING_HPP
+
+#include <cstdint>
+
+#include "types.hpp"
+
+namespace math::sampling {
+  /// Point sets on the unit square [0, 1)^2.
+  ///  - e_Random:     independent uniform points (plain Monte Carlo)
+  ///  - e_Sobol:      first two dimensions of the Sobol sequence, Owen scrambled
+  ///  - e_Halton:     Halton sequence in bases 2 and 3, randomly shifted modulo 1
+  ///  - e_Stratified: Latin hypercube, exactly one point in each of the count rows and columns
+  ///  - e_Antithetic: uniform points in pairs (u, v) and (1 - u, 1 - v), so that functions monotonic in each
+  ///                  coordinate (such as the tilt of a mosaic sample in v) give negatively correlated partners
+  enum class method { e_Random, e_Sobol, e_Halton, e_Stratified, e_Antithetic };
+
+  /// Generates count points (one per column) using the given method. All randomness (the points themselves, or the
+  /// randomisation of the quasi-random and stratified sets) comes from a philox4x32 generator with the given key and the
+  /// point index, so the result only depends on (m, count, key) and not on the number of threads.
+  rmatrix_t<2, n_dynamic> unit_square(method m, uint_t count, std::uint64_t key);
+
+  rmatrix_t<2, n_dynamic> random(uint_t count, std::uint64_t key);
+  rmatrix_t<2, n_dynamic> sobol(uint_t count, std::uint64_t key);
+  rmatrix_t<2, n_dynamic> halton(uint_t count, std::uint64_t key);
+  rmatrix_t<2, n_dynamic> stratified(uint_t count, std::uint64_t key);
+  rmatrix_t<2, n_dynamic> antithetic(uint_t count, std::uint64_t key);
+}    // namespace math::sampling
+
+#endif    //XRD_SAMPLING_HPP
@@ -0,0 +1,132 @@
+#ifndef XRD_SUMMATION_HPP
+#define XRD_SUMMATION_HPP
+
+#include <cmath>
+
+#include "types.hpp"
+
+namespace math::summation {
+  /// Floating point summation schemes, from fastest to most accurate.
+  ///  - e_Naive:        plain running sum, error grows like n eps
+  ///  - e_Pairwise:     blocks are summed as a binary tree (error ~ log(n) eps), the block sums with e_Neumaier
+  ///  - e_Neumaier:     compensated (improved Kahan) summation, error ~ eps independent of n
+  ///  - e_DoubleDouble: running sum kept as an unevaluated pair hi + lo (about twice the working precision)
+  enum class method { e_Naive, e_Pairwise, e_Neumaier, e_DoubleDouble };
+
+  /// s + e = a + b exactly, with s = fl(a + b).
+  template <typename T>
+  inline void two_sum(T a, T b, T& s, T& e) noexcept {
+    s = a + b;
+    const T bb = s - a;
+    e = (a - (s - bb)) + (b - bb);
+  }
+
+  /// As two_sum(), but requires |a| >= |b|.
+  template <typename T>
+  inline void fast_two_sum(T a, T b, T& s, T& e) noexcept {
+    s = a + b;
+    e = b - (s - a);
+  }
+
+  /// Pairwise sum of x[0..n) in type T, with a vectorised loop below k_PairwiseBlock elements.
+  template <typename T, typename U = T>
+  [[nodiscard]] T pairwise(const U* x, sint_t n) noexcept {
+    constexpr sint_t k_PairwiseBlock = 32;
+
+    if(n <= k_PairwiseBlock) {
+      T sum = 0;
+#pragma omp simd reduction(+ : sum)
+      for(sint_t ii = 0; ii < n; ++ii)
+        sum += x[ii];
+      return sum;
+    }
+    const sint_t half = n / 2;
+    return pairwise<T>(x, half) + pairwise<T>(x + half, n - half);
+  }
+
+  /// Running sum in type T using one of the methods above. The state is two T values for every method, so an
+  /// accumulator can be kept per angle of a pattern. Compensation relies on IEEE rounding: do not build with -ffast-math.
+  template <typename T>
+  class accumulator {
+   public:
+    explicit accumulator(method m = method::e_Naive) noexcept : m_Method{m} {}
+
+    inline void add(T x) noexcept {
+      switch(m_Method) {
+        case method::e_Naive:
+          m_Hi += x;
+          break;
+        case method::e_Pairwise:
+        case method::e_Neumaier:
+          neumaier(m_Hi, m_Lo, x);
+          break;
+        case method::e_DoubleDouble:
+          double_double(m_Hi, m_Lo, x);
+          break;
+      }
+    }
+
+    /// Adds x[0..n), converting every element to T first.
+    template <typename U>
+    inline void add(const U* x, sint_t n) noexcept {
+      /* the state is kept in locals so that it can stay in registers over the loop */
+      T hi = m_Hi, lo = m_Lo;
+      switch(m_Method) {
+        case method::e_Naive: {
+          T sum = 0;
+#pragma omp simd reduction(+ : sum)
+          for(sint_t ii = 0; ii < n; ++ii)
+            sum += x[ii];
+          hi += sum;
+          break;
+        }
+        case method::e_Pairwise:
+          neumaier(hi, lo, pairwise<T>(x, n));
+          break;
+        case method::e_Neumaier:
+          for(sint_t ii = 0; ii < n; ++ii)
+            neumaier(hi, lo, static_cast<T>(x[ii]));
+          break;
+        case method::e_DoubleDouble:
+          for(sint_t ii = 0; ii < n; ++ii)
+            double_double(hi, lo, static_cast<T>(x[ii]));
+          break;
+      }
+      m_Hi = hi;
+      m_Lo = lo;
+    }
+
+    inline accumulator& operator+=(T x) noexcept {
+      add(x);
+      return *this;
+    }
+
+    [[nodiscard]] inline T value() const noexcept {
+      return m_Hi + m_Lo;
+    }
+
+    [[nodiscard]] inline method get_method() const noexcept {
+      return m_Method;
+    }
+
+   private:
+    static inline void neumaier(T& sum, T& c, T x) noexcept {
+      const T s = sum + x;
+      /* the compensation recovers the low order bits of whichever operand is smaller */
+      c += (std::abs(sum) >= std::abs(x)) ? ((sum - s) + x) : ((x - s) + sum);
+      sum = s;
+    }
+
+    static inline void double_double(T& hi, T& lo, T x) noexcept {
+      T s, e;
+      two_sum(hi, x, s, e);
+      fast_two_sum(s, e + lo, hi, lo);
+    }
+
+    method m_Method;
+    T m_Hi = 0;
+    T m_Lo = 0;
+  };
+}    // namespace math::summation
+
+#endif    //XRD_SUMMATION_HPP
@@ -0,0 +1,302 @@
+#ifndef XRD_VEC_HPP
+#define XRD_VEC_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+
+#include "types.hpp"
+
+/* Branch-free polynomial sin, cos and exp that the compiler can inline and vectorise in `omp simd` loops, unlike the
+ * libm calls (which are only vectorised with -ffast-math). */
+namespace math::vec {
+  /// Accuracy tiers of the double precision functions.
+  ///  - e_Fast:     relative error around 1e-7 (the single precision polynomials, evaluated in double)
+  ///  - e_Accurate: about 1 ulp (the fdlibm polynomials)
+  /// float arguments always use the single precision polynomials (about 1 ulp in float). long double arguments are
+  /// passed on to libm.
+  enum class tier { e_Fast, e_Accurate };
+
+  namespace details {
+    template <typename T>
+    struct float_traits;
+
+    template <>
+    struct float_traits<double> {
+      using bits_type = std::uint64_t;
+      /* x + k_RoundShift - k_RoundShift rounds x to an integer k, and leaves k in the low bits of x + k_RoundShift */
+      static constexpr double k_RoundShift = 0x1.8p52;
+      static constexpr int k_MantissaBits = 52;
+      static constexpr bits_type k_ExponentBias = 1023;
+      static constexpr double k_ExpMax = 7.09782712893383973096e+02;
+      static constexpr double k_ExpMin = -7.08396418532264106224e+02;
+      static constexpr double k_ReductionLimit = 1e6;
+    };
+
+    template <>
+    struct float_traits<float> {
+      using bits_type = std::uint32_t;
+      static constexpr float k_RoundShift = 0x1.8p23f;
+      static constexpr int k_MantissaBits = 23;
+      static constexpr bits_type k_ExponentBias = 127;
+      static constexpr float k_ExpMax = 8.8722839e+01f;
+      static constexpr float k_ExpMin = -8.7336544e+01f;
+      static constexpr float k_ReductionLimit = 1e5f;
+    };
+
+    template <typename T>
+    concept polynomial = std::is_same_v<T, double> || std::is_same_v<T, float>;
+
+    /* x = k pi/2 + r, |r| <= pi/4, by Cody-Waite reduction in three parts (the first with trailing zeros, so that
+     * k times it is exact). Accurate while k fits in the zero bits: |x| up to about 1e6 in double, 1e5 in float. */
+    template <polynomial T>
+    inline T reduce_half_pi(T x, typename float_traits<T>::bits_type& k_bits) noexcept {
+      using traits = float_traits<T>;
+
+      T pio2_1, pio2_2, pio2_3;
+      if constexpr(std::is_same_v<T, double>) {
+        pio2_1 = 1.57079632673412561417e+00;
+        pio2_2 = 6.07710050630396597660e-11;
+        pio2_3 = 2.02226624871116645580e-21;
+      } else {
+        pio2_1 = 1.5703125f;
+        pio2_2 = 4.837512969970703125e-4f;
+        pio2_3 = 7.54978995489188216e-8f;
+      }
+
+      const T shifted = x * T(0.636619772367581343076) + traits::k_RoundShift;
+      const T k = shifted - traits::k_RoundShift;
+      k_bits = std::bit_cast<typename traits::bits_type>(shifted);
+      return ((x - k * pio2_1) - k * pio2_2) - k * pio2_3;
+    }
+
+    /* sin(r) and cos(r) for |r| <= pi/4 */
+    template <tier A, polynomial T>
+    inline void sincos_kernel(T r, T& s, T& c) noexcept {
+      const T z = r * r;
+      if constexpr(A == tier::e_Accurate && std::is_same_v<T, double>) {
+        s = r + (r * z) * (-1.66666666666666324348e-01 +
+                           z * (8.33333333332248946124e-03 +
+                                z * (-1.98412698298579493134e-04 + z * (2.75573137070700676789e-06 + z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+
+        /* 1 - z/2 is split so that its rounding error is not amplified */
+        const T hz = z / 2, w = 1 - hz;
+        c = w + (((1 - w) - hz) +
+                 (z * z) * (4.16666666666666019037e-02 +
+                            z * (-1.38888888888741095749e-03 +
+                                 z * (2.48015872894767294178e-05 + z * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11))))));
+      } else {
+        s = r + (r * z) * (T(-1.6666654611e-1) + z * (T(8.3321608736e-3) + z * T(-1.9515295891e-4)));
+        c = 1 - z / 2 + (z * z) * (T(4.166664568298827e-2) + z * (T(-1.388731625493765e-3) + z * T(2.443315711809948e-5)));
+      }
+    }
+
+    /* exp(r) for |r| <= ln(2)/2, where r = hi - lo */
+    template <tier A, polynomial T>
+    inline T exp_kernel(T hi, T lo) noexcept {
+      const T r = hi - lo;
+      if constexpr(A == tier::e_Accurate && std::is_same_v<T, double>) {
+        /* fdlibm: rational approximation in r^2 */
+        const T t = r * r;
+        const T c =
+            r - t * (1.66666666666666019037e-01 +
+                     t * (-2.77777777770155933842e-03 + t * (6.61375632143793436117e-05 + t * (-1.65339022054652515390e-06 + t * 4.13813679705723846039e-08))));
+        return 1 - ((lo - (r * c) / (2 - c)) - hi);
+      } else {
+        const T p = T(5.0000001201e-1) +
+                    r * (T(1.6666665459e-1) + r * (T(4.1665795894e-2) + r * (T(8.3334519073e-3) + r * (T(1.3981999507e-3) + r * T(1.9875691500e-4)))));
+        return 1 + r + (r * r) * p;
+      }
+    }
+  }    // namespace details
+
+  /// Largest |x| for which the argument reduction of sincos(), sin() and cos() is accurate.
+  template <typename T>
+  requires std::is_floating_point_v<T>
+  [[nodiscard]] constexpr T reduction_limit() noexcept {
+    if constexpr(details::polynomial<T>)
+      return details::float_traits<T>::k_ReductionLimit;
+    else
+      return std::numeric_limits<T>::infinity();
+  }
+
+  /// sin(x) and cos(x) in one argument reduction. Branch-free, so only valid for |x| <= reduction_limit<T>() (about 1e6
+  /// in double, 1e5 in float); larger arguments give wrong results. Loops over unbounded arguments should use the span
+  /// versions, which fall back to libm past the limit.
+  template <tier A = tier::e_Accurate, typename T>
+  requires std::is_floating_point_v<T>
+  inline void sincos(T x, T& s, T& c) noexcept {
+    if constexpr(details::polynomial<T>) {
+      using bits_type = typename details::float_traits<T>::bits_type;
+      constexpr int k_SignShift = 8 * sizeof(T) - 2;
+
+      bits_type q;
+      const T r = details::reduce_half_pi(x, q);
+
+      T sr, cr;
+      details::sincos_kernel<A>(r, sr, cr);
+
+      /* quadrant q (mod 4): swap sin and cos for odd quadrants, then flip the signs. Done on the bits, since 64-bit
+       * integer compares do not vectorise before SSE4.1. */
+      const bits_type s_bits = std::bit_cast<bits_type>(sr), c_bits = std::bit_cast<bits_type>(cr);
+      const bits_type swap = (s_bits ^ c_bits) & (bits_type(0) - (q & 1));
+      s = std::bit_cast<T>((s_bits ^ swap) ^ ((q & 2) << k_SignShift));
+      c = std::bit_cast<T>((c_bits ^ swap) ^ (((q + 1) & 2) << k_SignShift));
+    } else {
+      s = std::sin(x);
+      c = std::cos(x);
+    }
+  }
+
+  template <tier A = tier::e_Accurate, typename T>
+  requires std::is_floating_point_v<T>
+  [[nodiscard]] inline T sin(T x) noexcept {
+    T s, c;
+    sincos<A>(x, s, c);
+    return s;
+  }
+
+  template <tier A = tier::e_Accurate, typename T>
+  requires std::is_floating_point_v<T>
+  [[nodiscard]] inline T cos(T x) noexcept {
+    T s, c;
+    sincos<A>(x, s, c);
+    return c;
+  }
+
+  /// exp(x); results below the smallest normal number are flushed to zero.
+  template <tier A = tier::e_Accurate, typename T>
+  requires std::is_floating_point_v<T>
+  [[nodiscard]] inline T exp(T x) noexcept {
+    if constexpr(details::polynomial<T>) {
+      using traits = details::float_traits<T>;
+      using bits_type = typename traits::bits_type;
+
+      T ln2_hi, ln2_lo;
+      if constexpr(std::is_same_v<T, double>) {
+        ln2_hi = 6.93147180369123816490e-01;
+        ln2_lo = 1.90821492927058770002e-10;
+      } else {
+        ln2_hi = 0.693359375f;
+        ln2_lo = -2.12194440e-4f;
+      }
+
+      /* x = k ln(2) + r */
+      const T xc = std::min(std::max(x, traits::k_ExpMin), traits::k_ExpMax);
+      const T shifted = xc * T(1.44269504088896338700) + traits::k_RoundShift;
+      const T k = shifted - traits::k_RoundShift;
+      bits_type k_bits = std::bit_cast<bits_type>(shifted);
+
+      T y = details::exp_kernel<A>(xc - k * ln2_hi, k * ln2_lo);
+
+      /* 2^k from the low bits of shifted; k one above the largest exponent is done as 2 * 2^(k - 1) */
+      const bool top = (k > T(traits::k_ExponentBias));
+      y = top ? 2 * y : y;
+      k_bits = top ? k_bits - 1 : k_bits;
+      y *= std::bit_cast<T>(static_cast<bits_type>((k_bits + traits::k_ExponentBias) << traits::k_MantissaBits));
+
+      y = (x > traits::k_ExpMax) ? std::numeric_limits<T>::infinity() : y;
+      return (x < traits::k_ExpMin) ? T(0) : y;
+    } else {
+      return std::exp(x);
+    }
+  }
+
+  /// Whether every element of x is within reduction_limit<T>().
+  template <typename T>
+  [[nodiscard]] inline bool in_reduction_range(std::span<const T> x) noexcept {
+    T widest = 0;
+#pragma omp simd reduction(max : widest)
+    for(size_t ii = 0; ii < x.size(); ++ii)
+      widest = std::max(widest, std::abs(x[ii]));
+    return widest <= reduction_limit<T>();
+  }
+
+  /// Element-wise versions; out may be the same array as x. Elements past reduction_limit<T>() are redone with libm after
+  /// the vectorised loop.
+  template <tier A = tier::e_Accurate, typename T>
+  inline void sincos(std::span<const T> x, std::span<T> s, std::span<T> c) noexcept {
+    const bool in_range = in_reduction_range(x);
+#pragma omp simd
+    for(size_t ii = 0; ii < x.size(); ++ii)
+      sincos<A>(x[ii], s[ii], c[ii]);
+    if(!in_range) [[unlikely]]
+      for(size_t ii = 0; ii < x.size(); ++ii)
+        if(std::abs(x[ii]) > reduction_limit<T>()) {
+          s[ii] = std::sin(x[ii]);
+          c[ii] = std::cos(x[ii]);
+        }
+  }
+  template <tier A = tier::e_Accurate, typename T>
+  inline void sin(std::span<const T> x, std::span<T> out) noexcept {
+    const bool in_range = in_reduction_range(x);
+#pragma omp simd
+    for(size_t ii = 0; ii < x.size(); ++ii)
+      out[ii] = sin<A>(x[ii]);
+    if(!in_range) [[unlikely]]
+      for(size_t ii = 0; ii < x.size(); ++ii)
+        if(std::abs(x[ii]) > reduction_limit<T>())
+          out[ii] = std::sin(x[ii]);
+  }
+  template <tier A = tier::e_Accurate, typename T>
+  inline void cos(std::span<const T> x, std::span<T> out) noexcept {
+    const bool in_range = in_reduction_range(x);
+#pragma omp simd
+    for(size_t ii = 0; ii < x.size(); ++ii)
+      out[ii] = cos<A>(x[ii]);
+    if(!in_range) [[unlikely]]
+      for(size_t ii = 0; ii < x.size(); ++ii)
+        if(std::abs(x[ii]) > reduction_limit<T>())
+          out[ii] = std::cos(x[ii]);
+  }
+  template <tier A = tier::e_Accurate, typename T>
+  inline void exp(std::span<const T> x, std::span<T> out) noexcept {
+#pragma omp simd
+    for(size_t ii = 0; ii < x.size(); ++ii)
+      out[ii] = exp<A>(x[ii]);
+  }
+
+  /// Functors for Eigen's unaryExpr(), e.g. a.unaryExpr(math::vec::sin_op{}). sin_op and cos_op fall back to libm past
+  /// reduction_limit<T>().
+  template <tier A = tier::e_Accurate>
+  struct sin_op {
+    template <typename T>
+    inline T operator()(T x) const noexcept {
+      return (std::abs(x) > reduction_limit<T>()) ? std::sin(x) : sin<A>(x);
+    }
+  };
+  template <tier A = tier::e_Accurate>
+  struct cos_op {
+    template <typename T>
+    inline T operator()(T x) const noexcept {
+      return (std::abs(x) > reduction_limit<T>()) ? std::cos(x) : cos<A>(x);
+    }
+  };
+  template <tier A = tier::e_Accurate>
+  struct exp_op {
+    template <typename T>
+    inline T operator()(T x) const noexcept {
+      return exp<A>(x);
+    }
+  };
+
+  /// Lazy element-wise expressions on Eigen arrays, e.g. rdata_t y = math::vec::exp(-x.square()).
+  template <tier A = tier::e_Accurate, typename Derived>
+  [[nodiscard]] inline auto sin(const Eigen::ArrayBase<Derived>& x) {
+    return x.unaryExpr(sin_op<A>{});
+  }
+  template <tier A = tier::e_Accurate, typename Derived>
+  [[nodiscard]] inline auto cos(const Eigen::ArrayBase<Derived>& x) {
+    return x.unaryExpr(cos_op<A>{});
+  }
+  template <tier A = tier::e_Accurate, typename Derived>
+  [[nodiscard]] inline auto exp(const Eigen::ArrayBase<Derived>& x) {
+    return x.unaryExpr(exp_op<A>{});
+  }
+}    // namespace math::vec
+
+#endif    //XRD_VEC_HPP
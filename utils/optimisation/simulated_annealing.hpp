@@ -2,11 +2,33 @@
 #define XRD_SIMULATED_ANNEALING_HPP
 
 #include "math.hpp"
+#include "math/random.hpp"
 #include "types.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <limits>
+#include <random>
+
 #include <fmt/format.h>
+#include <omp.h>
 
 namespace opt {
+  /// Options of simulated_annealer::run_parallel().
+  struct parallel_chains {
+    /// chains run at the same time (0: one per OpenMP thread); the threads left over go to the OpenMP regions inside
+    /// the energy function, so that the machine is not oversubscribed
+    sint_t threads = 0;
+    /// with replica exchange, chain i runs at ratio^i times the temperature of the schedule and the states of
+    /// neighbouring chains are swapped every exchange_interval steps with the parallel tempering probability
+    /// min(1, exp((e_i - e_j)(1/t_i - 1/t_j))); 0 keeps the chains independent
+    sint_t exchange_interval = 0;
+    real_t temperature_ratio = 1.5;
+    /// seeds the random streams of the chains (see simulated_annealer::run_parallel())
+    std::uint64_t seed = math::rand::default_seed();
+  };
+
   template <typename AnnealingTraits, bool Trace = false>
   class simulated_annealer {
     using traits_type = AnnealingTraits;
@@ -61,7 +83,144 @@ namespace opt {
       return sMin;
     }
 
+    /// Same as run(), but the num_chains chains (the iterations of run()) are annealed concurrently. Each chain draws from
+    /// its own random streams: the acceptance tests from a Philox stream, and the traits from the calling thread's
+    /// generator (math::rand::tl_Generator, also behind math::rand::unit()), reseeded from the chain whenever a thread
+    /// picks it up. The result only depends on the seed, not on the number of threads, as long as the traits draw all
+    /// their random numbers that way on the calling thread (not from shared counters, and not inside their own parallel
+    /// regions, whose threads are not reseeded). The best solution so far is shared between the chains by a lock-free
+    /// minimum on its energy; the solution itself stays with its chain until the end. The traits must be safe to call
+    /// concurrently. The generator of the calling thread is restored on return; those of the other threads of the team
+    /// are left as the last chain they ran.
+    solution_type run_parallel(const traits_type& traits, const sint_t num_chains, const sint_t steps, const parallel_chains& options = {}) const {
+      if(num_chains <= 0)
+        throw std::runtime_error(fmt::format("invalid num_chains ({})", num_chains));
+      if(steps <= 0)
+        throw std::runtime_error(fmt::format("invalid steps ({})", steps));
+      if(options.exchange_interval < 0)
+        throw std::runtime_error(fmt::format("invalid exchange_interval ({})", options.exchange_interval));
+      if(!(options.temperature_ratio >= 1))
+        throw std::runtime_error(fmt::format("invalid temperature_ratio ({}): must be at least 1", options.temperature_ratio));
+
+      /* chains on the outer team, the remaining cores to the nested regions of each chain */
+      const sint_t available = omp_get_max_threads();
+      const sint_t outer = std::min<sint_t>(num_chains, (options.threads > 0) ? options.threads : available);
+      const sint_t inner = std::max<sint_t>(1, available / outer);
+      const int levels = omp_get_max_active_levels();
+      if(inner > 1)
+        omp_set_max_active_levels(std::max(levels, 2));
+
+      const bool exchange = options.exchange_interval > 0 && num_chains > 1;
+      const sint_t interval = exchange ? options.exchange_interval : steps;
+
+      if constexpr(Trace)
+        fmt::print("Started simulated annealing with {0} chains on {1} x {2} threads and {3} steps per chain{4}:\n", num_chains, outer, inner, steps,
+                   exchange ? fmt::format(", exchanging every {} steps", interval) : "");
+
+      stl::vector<chain> chains(num_chains);
+      std::atomic<real_t> best = std::numeric_limits<real_t>::max();
+
+      /* the calling thread joins the team, and its generator is reseeded like the others */
+      const std::mt19937_64 caller_generator = math::rand::tl_Generator;
+
+      for(sint_t first = 0, segment = 0; first < steps; first += interval, ++segment) {
+        const sint_t last = std::min(first + interval, steps);
+
+#pragma omp parallel for num_threads(outer) schedule(dynamic, 1) default(none) shared(traits, options, chains, best, first, last, segment, num_chains, inner, exchange)
+        for(sint_t k = 0; k < num_chains; ++k) {
+          omp_set_num_threads(inner);
+          math::rand::tl_Generator.seed(math::rand::derive_key(options.seed, std::uint64_t(k) << 32 | segment));
+
+          chain& c = chains[k];
+          if(first == 0) {
+            c.s = traits.initial_solution();
+            c.e = traits.energy(c.s);
+            c.s_min = c.s;
+            c.e_min = c.e;
+            update_minimum(best, c.e);
+          }
+          /* the temperature ladder only applies to replica exchange; independent chains all follow the schedule of run() */
+          anneal(traits, c, k, first, last, exchange ? std::pow(options.temperature_ratio, k) : real_t(1), options.seed, best);
+        }
+
+        if(exchange && last < steps) {
+          /* alternate between the even and the odd pairs, so that every pair gets its turn */
+          math::rand::philox_engine rng{math::rand::derive_key(options.seed, num_chains), static_cast<std::uint32_t>(segment)};
+          for(sint_t k = segment % 2; k + 1 < num_chains; k += 2) {
+            const real_t t0 = T(last) * std::pow(options.temperature_ratio, k), t1 = t0 * options.temperature_ratio;
+            if(std::exp(std::min<real_t>(0, (chains[k].e - chains[k + 1].e) * (1 / t0 - 1 / t1))) >= to_unit(rng())) {
+              std::swap(chains[k].s, chains[k + 1].s);
+              std::swap(chains[k].e, chains[k + 1].e);
+            }
+          }
+        }
+      }
+
+      omp_set_max_active_levels(levels);
+      math::rand::tl_Generator = caller_generator;
+
+      return std::min_element(chains.begin(), chains.end(), [](const chain& a, const chain& b) { return a.e_min < b.e_min; })->s_min;
+    }
+
    private:
+    struct chain {
+      solution_type s;
+      real_t e;
+      solution_type s_min;
+      real_t e_min;
+    };
+
+    /// Steps [first, last) of chain k, at temperature_scale times the schedule.
+    void anneal(const traits_type& traits, chain& c, sint_t k, sint_t first, sint_t last, real_t temperature_scale, std::uint64_t seed,
+                std::atomic<real_t>& best) const {
+      /* counter-based, so the stream continues across segments without keeping any state */
+      const math::rand::philox4x32 rng{math::rand::derive_key(seed, k)};
+
+      for(sint_t l = first; l < last; ++l) {
+        const real_t t = temperature_scale * T(l);
+
+        solution_type sNew = traits.random_neighbour(c.s);
+        real_t ep = traits.energy(sNew);
+
+        if(P(c.e, ep, t) >= rng.uniform2(l)[0]) {
+          c.s = sNew;
+          c.e = ep;
+
+          if(c.e < c.e_min) {
+            c.s_min = c.s;
+            c.e_min = c.e;
+
+            if(update_minimum(best, c.e)) {
+              if constexpr(Trace) {
+                /* one chain at a time, so that the lines of concurrent chains do not interleave */
+#pragma omp critical(opt_simulated_annealer_trace)
+                {
+                  if constexpr(fmt::has_formatter<solution_type, fmt::format_context>::value)
+                    fmt::print("  On step {0} of chain {1}, a better solution {2} with energy {3} was found.\n", l + 1, k + 1, c.s_min, c.e_min);
+                  else
+                    fmt::print("  On step {0} of chain {1}, a better solution with energy {2} was found.\n", l + 1, k + 1, c.e_min);
+                  std::fflush(stdout);
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+
+    /// Lowers best to e unless it is already lower; returns whether it was lowered.
+    inline static bool update_minimum(std::atomic<real_t>& best, real_t e) noexcept {
+      real_t current = best.load(std::memory_order_relaxed);
+      while(e < current)
+        if(best.compare_exchange_weak(current, e, std::memory_order_relaxed))
+          return true;
+      return false;
+    }
+
+    inline static real_t to_unit(std::uint64_t r) noexcept {
+      return math::rand::philox4x32::to_unit(static_cast<std::uint32_t>(r >> 32), static_cast<std::uint32_t>(r));
+    }
+
     /*
     * This static method returns the probability of jumping from a solution  with
     * energy e to a solution with energy ep at temperature t. This probability function
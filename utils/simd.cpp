@@ -0,0 +1,81 @@
+#include "simd.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+namespace {
+  bool supported(simd::isa i) noexcept {
+    switch(i) {
+      case simd::isa::e_Generic:
+        return true;
+#if XRD_SIMD_MULTIVERSIONING
+      /* libgcc only reports AVX features when the operating system saves the wide registers */
+      case simd::isa::e_AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+      case simd::isa::e_AVX512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl") &&
+               __builtin_cpu_supports("avx512bw") && supported(simd::isa::e_AVX2);
+#endif
+      default:
+        return false;
+    }
+  }
+
+  std::atomic<simd::isa>& selected_isa() {
+    static std::atomic<simd::isa> s_Selected = [] {
+      /* a bad override must not take down a kernel call, so it is reported and ignored */
+      if(const char* name = std::getenv("XRD_SIMD")) {
+        try {
+          const simd::isa i = simd::from_string(name);
+          if(supported(i))
+            return i;
+          fmt::print(stderr, "XRD_SIMD={}: instruction set not supported by this CPU, ignored\n", name);
+        } catch(const std::invalid_argument& e) {
+          fmt::print(stderr, "XRD_SIMD: {}, ignored\n", e.what());
+        }
+      }
+      return simd::detect();
+    }();
+    return s_Selected;
+  }
+}    // namespace
+
+simd::isa simd::detect() noexcept {
+  for(isa i : {isa::e_AVX512, isa::e_AVX2})
+    if(supported(i))
+      return i;
+  return isa::e_Generic;
+}
+
+simd::isa simd::selected() noexcept {
+  return selected_isa().load(std::memory_order_relaxed);
+}
+
+void simd::force(isa i) {
+  if(!supported(i))
+    throw std::invalid_argument(fmt::format("instruction set not supported by this CPU: {}", to_string(i)));
+  selected_isa().store(i, std::memory_order_relaxed);
+}
+
+std::string_view simd::to_string(isa i) noexcept {
+  switch(i) {
+    case isa::e_AVX2:
+      return "avx2";
+    case isa::e_AVX512:
+      return "avx512";
+    default:
+    case isa::e_Generic:
+      return "generic";
+  }
+}
+
+simd::isa simd::from_string(std::string_view name) {
+  for(isa i : {isa::e_Generic, isa::e_AVX2, isa::e_AVX512})
+    if(name == to_string(i))
+      return i;
+  throw std::invalid_argument(fmt::format("unrecognized instruction set: {}", name));
+}
@@ -0,0 +1,53 @@
+#ifndef XRD_SIMD_HPP
+#define XRD_SIMD_HPP
+
+#include <array>
+#include <string_view>
+
+/* Function multiversioning: the hot kernels are written once as inline bodies and instantiated in wrappers compiled for
+ * each instruction set below. The wrappers go in a table indexed by simd::isa, and simd::dispatch() picks the entry
+ * for the instruction set selected at startup. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define XRD_SIMD_MULTIVERSIONING 1
+#  define XRD_SIMD_INLINE [[gnu::always_inline]] inline
+#  define XRD_SIMD_TARGET_AVX2 [[gnu::target("avx2,fma")]]
+#  define XRD_SIMD_TARGET_AVX512 [[gnu::target("avx512f,avx512dq,avx512vl,avx512bw,avx2,fma")]]
+#else
+#  define XRD_SIMD_MULTIVERSIONING 0
+#  define XRD_SIMD_INLINE inline
+#  define XRD_SIMD_TARGET_AVX2
+#  define XRD_SIMD_TARGET_AVX512
+#endif
+
+namespace simd {
+  /// Instruction sets with their own kernel variants.
+  ///  - e_Generic: whatever the build flags allow (SSE2 on a plain x86-64 build)
+  ///  - e_AVX2:    AVX2 and FMA (Haswell, Zen and later)
+  ///  - e_AVX512:  AVX-512 F, DQ, VL and BW (Skylake-SP, Ice Lake, Zen 4 and later)
+  enum class isa { e_Generic, e_AVX2, e_AVX512 };
+
+  constexpr std::size_t k_IsaCount = 3;
+
+  /// Best instruction set supported by this CPU (and operating system).
+  [[nodiscard]] isa detect() noexcept;
+
+  /// Instruction set used by the dispatched kernels. Initialised on first use to detect(), or to the value of the
+  /// XRD_SIMD environment variable ("generic", "avx2" or "avx512") when it is set and supported.
+  [[nodiscard]] isa selected() noexcept;
+
+  /// Overrides the selected instruction set, for testing and benchmarking. Throws std::invalid_argument if the CPU
+  /// does not support it. Kernels that cache their dispatch (e.g. a diffraction workspace) keep the old choice.
+  void force(isa i);
+
+  [[nodiscard]] std::string_view to_string(isa i) noexcept;
+  /// Inverse of to_string(); throws std::invalid_argument on unknown names.
+  [[nodiscard]] isa from_string(std::string_view name);
+
+  /// Entry of a per instruction set table for the selected instruction set.
+  template <typename F>
+  [[nodiscard]] inline const F& dispatch(const std::array<F, k_IsaCount>& table) noexcept {
+    return table[static_cast<std::size_t>(selected())];
+  }
+}    // namespace simd
+
+#endif    //XRD_SIMD_HPP
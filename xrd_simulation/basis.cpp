@@ -1,11 +1,17 @@
 #include "basis.hpp"
 
+#include <fmt/format.h>
+
 #include <nlohmann/json.hpp>
 
 #include <types_json.hpp>
 
+#include "tables/form_factor.hpp"
+
 void nlohmann::adl_serializer<xrd::basis::atom>::from_json(const nlohmann::json& j, xrd::basis::atom& a) {
   j.at("form").get_to(a.f);
+  if(a.f < 1 || a.f > xrd::tables::k_F0_max_Z)
+    throw std::out_of_range(fmt::format("no form factor for element {} (must be between 1 and {})", a.f, xrd::tables::k_F0_max_Z));
   j.at("mass").get_to(a.m);
   j.at("position").get_to(a.r);
 }
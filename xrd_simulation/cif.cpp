@@ -0,0 +1,221 @@
+#include "cif.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include "tables/elements.hpp"
+
+namespace {
+  struct loop {
+    stl::vector<std::string> tags;
+    stl::vector<std::string> values;
+  };
+
+  struct data_block {
+    std::map<std::string, std::string> items;
+    stl::vector<loop> loops;
+
+    [[nodiscard]] const std::string* item(std::string_view tag) const {
+      const auto it = items.find(std::string(tag));
+      return (it == items.end()) ? nullptr : &it->second;
+    }
+
+    /* column of a looped tag, or empty if no loop has it */
+    [[nodiscard]] stl::vector<std::string> column(std::string_view tag) const {
+      for(const auto& l : loops) {
+        const auto it = std::find(l.tags.begin(), l.tags.end(), tag);
+        if(it == l.tags.end())
+          continue;
+
+        stl::vector<std::string> result;
+        const size_t width = l.tags.size();
+        for(size_t ii = it - l.tags.begin(); ii < l.values.size(); ii += width)
+          result.push_back(l.values[ii]);
+        return result;
+      }
+      return {};
+    }
+  };
+
+  std::string lower(std::string_view s) {
+    std::string result(s);
+    std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) { return std::tolower(c); });
+    return result;
+  }
+
+  /* whitespace separated tokens, quoted strings (the quote only closes before whitespace) and ;-delimited text fields,
+   * without comments */
+  stl::vector<std::string> tokenize(std::string_view text) {
+    stl::vector<std::string> tokens;
+    std::istringstream lines{std::string(text)};
+    std::string line;
+    while(std::getline(lines, line)) {
+      if(!line.empty() && line.back() == '\r')
+        line.pop_back();
+
+      if(!line.empty() && line.front() == ';') {
+        std::string field = line.substr(1);
+        while(std::getline(lines, line) && !(!line.empty() && line.front() == ';'))
+          field += "\n" + line;
+        tokens.push_back(field);
+        continue;
+      }
+
+      size_t pos = 0;
+      while(pos < line.size()) {
+        if(std::isspace(static_cast<unsigned char>(line[pos]))) {
+          ++pos;
+        } else if(line[pos] == '#') {
+          break;
+        } else if(line[pos] == '\'' || line[pos] == '"') {
+          const char quote = line[pos];
+          size_t end = pos + 1;
+          while(end < line.size() && !(line[end] == quote && (end + 1 == line.size() || std::isspace(static_cast<unsigned char>(line[end + 1])))))
+            ++end;
+          tokens.push_back(line.substr(pos + 1, end - pos - 1));
+          pos = end + 1;
+        } else {
+          size_t end = pos;
+          while(end < line.size() && !std::isspace(static_cast<unsigned char>(line[end])))
+            ++end;
+          tokens.push_back(line.substr(pos, end - pos));
+          pos = end;
+        }
+      }
+    }
+    return tokens;
+  }
+
+  data_block parse_block(std::string_view text) {
+    const stl::vector<std::string> tokens = tokenize(text);
+
+    data_block block;
+    bool in_block = false;
+    size_t ii = 0;
+    while(ii < tokens.size()) {
+      const std::string token = lower(tokens[ii]);
+      if(token.starts_with("data_")) {
+        if(in_block)
+          break;
+        in_block = true;
+        ++ii;
+      } else if(token == "loop_") {
+        loop l;
+        for(++ii; ii < tokens.size() && tokens[ii].starts_with("_"); ++ii)
+          l.tags.push_back(lower(tokens[ii]));
+        for(; ii < tokens.size() && !tokens[ii].starts_with("_"); ++ii) {
+          const std::string value = lower(tokens[ii]);
+          if(value == "loop_" || value.starts_with("data_"))
+            break;
+          l.values.push_back(tokens[ii]);
+        }
+        if(l.tags.empty() || l.values.size() % l.tags.size() != 0)
+          throw std::runtime_error(fmt::format("malformed CIF loop ({} values for {} tags)", l.values.size(), l.tags.size()));
+        block.loops.push_back(std::move(l));
+      } else if(token.starts_with("_")) {
+        if(ii + 1 >= tokens.size())
+          throw std::runtime_error(fmt::format("CIF item without a value: {}", tokens[ii]));
+        block.items[token] = tokens[ii + 1];
+        ii += 2;
+      } else {
+        /* global_ and save frames are not supported; skip whatever else there is */
+        ++ii;
+      }
+    }
+    return block;
+  }
+
+  bool is_missing(std::string_view value) {
+    return value == "?" || value == ".";
+  }
+
+  /* number without its standard uncertainty: "3.8500(12)" -> 3.85 */
+  real_t number(std::string_view value, std::string_view tag) {
+    const std::string_view digits = value.substr(0, value.find('('));
+    try {
+      if(!is_missing(digits) && !digits.empty())
+        return std::stod(std::string(digits));
+    } catch(const std::logic_error&) {
+    }
+    throw std::runtime_error(fmt::format("invalid number in CIF item {}: {}", tag, value));
+  }
+
+  real_t required_number(const data_block& block, std::string_view tag) {
+    const std::string* value = block.item(tag);
+    if(value == nullptr)
+      throw std::runtime_error(fmt::format("CIF item missing: {}", tag));
+    return number(*value, tag);
+  }
+
+  xrd::space_group read_space_group(const data_block& block) {
+    std::string symbol;
+    for(std::string_view tag : {"_space_group_name_h-m_alt", "_symmetry_space_group_name_h-m"})
+      if(const std::string* value = block.item(tag); value && !is_missing(*value)) {
+        symbol = *value;
+        break;
+      }
+
+    for(std::string_view tag : {"_space_group_symop_operation_xyz", "_symmetry_equiv_pos_as_xyz"})
+      if(const auto operations = block.column(tag); !operations.empty())
+        return xrd::space_group::from_operations(symbol, operations);
+
+    if(!symbol.empty())
+      return xrd::space_group::from_symbol(symbol);
+    for(std::string_view tag : {"_space_group_it_number", "_symmetry_int_tables_number"})
+      if(const std::string* value = block.item(tag); value && !is_missing(*value))
+        return xrd::space_group::from_symbol(*value);
+
+    return xrd::space_group::from_symbol("P1");
+  }
+
+  xrd::basis read_asymmetric_unit(const data_block& block) {
+    const auto x = block.column("_atom_site_fract_x"), y = block.column("_atom_site_fract_y"), z = block.column("_atom_site_fract_z");
+    auto types = block.column("_atom_site_type_symbol");
+    if(types.empty())
+      types = block.column("_atom_site_label");
+    const auto occupancies = block.column("_atom_site_occupancy");
+
+    if(x.empty() || x.size() != y.size() || x.size() != z.size() || x.size() != types.size())
+      throw std::runtime_error("CIF atom sites need _atom_site_fract_x/y/z and _atom_site_type_symbol or _atom_site_label");
+
+    stl::vector<xrd::basis::atom> atoms;
+    for(size_t ii = 0; ii < x.size(); ++ii) {
+      if(!occupancies.empty() && !is_missing(occupancies[ii]) && std::abs(number(occupancies[ii], "_atom_site_occupancy") - 1) > 1e-3)
+        throw std::runtime_error(fmt::format("partially occupied CIF site not supported: {} (occupancy {})", types[ii], occupancies[ii]));
+
+      const uint_t Z = xrd::tables::atomic_number(types[ii]);
+      const rvec3_t r{number(x[ii], "_atom_site_fract_x"), number(y[ii], "_atom_site_fract_y"), number(z[ii], "_atom_site_fract_z")};
+      atoms.push_back({Z, xrd::tables::element_data(Z).mass, r});
+    }
+    return xrd::basis(atoms);
+  }
+}    // namespace
+
+xrd::crystal xrd::read_cif(std::string_view file, std::optional<real_t> debye) {
+  std::ifstream fis(std::string{file});
+  if(!fis)
+    throw std::runtime_error(fmt::format("cannot open CIF file: {}", file));
+
+  std::stringstream text;
+  text << fis.rdbuf();
+  return parse_cif(text.str(), debye);
+}
+
+xrd::crystal xrd::parse_cif(std::string_view text, std::optional<real_t> debye) {
+  const data_block block = parse_block(text);
+
+  const lattice l = lattice::from_parameters(required_number(block, "_cell_length_a"), required_number(block, "_cell_length_b"),
+                                             required_number(block, "_cell_length_c"), required_number(block, "_cell_angle_alpha"),
+                                             required_number(block, "_cell_angle_beta"), required_number(block, "_cell_angle_gamma"));
+
+  if(debye)
+    return crystal(l, read_space_group(block), read_asymmetric_unit(block), *debye);
+  else
+    return crystal(l, read_space_group(block), read_asymmetric_unit(block));
+}
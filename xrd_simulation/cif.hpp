@@ -0,0 +1,25 @@
+#ifndef XRD_CIF_HPP
+#define XRD_CIF_HPP
+
+#include <optional>
+#include <string_view>
+
+#include <types.hpp>
+
+#include "crystal.hpp"
+
+namespace xrd {
+  /// Crystal from the first data block of a CIF file. Only the subset needed for a diffraction pattern is read:
+  ///  - the cell: _cell_length_a/b/c and _cell_angle_alpha/beta/gamma
+  ///  - the symmetry: the operations (_space_group_symop_operation_xyz or _symmetry_equiv_pos_as_xyz), or else the
+  ///    symbol (_space_group_name_H-M_alt or _symmetry_space_group_name_H-M) or number (_space_group_IT_number) of a
+  ///    built-in group; P1 without either
+  ///  - the asymmetric unit: _atom_site_fract_x/y/z with _atom_site_type_symbol (or _atom_site_label)
+  /// Standard uncertainties ("3.85(2)") are dropped. Partially occupied sites are rejected, since the basis has no
+  /// occupancies. Throws std::runtime_error if the file cannot be read or misses a required item.
+  crystal read_cif(std::string_view file, std::optional<real_t> debye = {});
+  /// Same as read_cif(), from the contents of a CIF file.
+  crystal parse_cif(std::string_view text, std::optional<real_t> debye = {});
+}    // namespace xrd
+
+#endif    //XRD_CIF_HPP
@@ -4,9 +4,26 @@
 
 #include <nlohmann/json.hpp>
 
+#include "cif.hpp"
+
 xrd::crystal nlohmann::adl_serializer<xrd::crystal>::from_json(const json& j) {
+  std::optional<real_t> debye;
   if(j.contains("debye_temperature"))
-    return xrd::crystal{j.at("lattice").get<xrd::lattice>(), j.at("basis").get<xrd::basis>(), j.at("debye_temperature").get<real_t>()};
+    debye = j.at("debye_temperature").get<real_t>();
+
+  if(j.contains("cif"))
+    return xrd::read_cif(j.at("cif").get<std::string>(), debye);
+
+  /* with a space group the basis is its asymmetric unit */
+  if(j.contains("space_group")) {
+    if(debye)
+      return xrd::crystal{j.at("lattice").get<xrd::lattice>(), j.at("space_group").get<xrd::space_group>(), j.at("basis").get<xrd::basis>(), *debye};
+    else
+      return xrd::crystal{j.at("lattice").get<xrd::lattice>(), j.at("space_group").get<xrd::space_group>(), j.at("basis").get<xrd::basis>()};
+  }
+
+  if(debye)
+    return xrd::crystal{j.at("lattice").get<xrd::lattice>(), j.at("basis").get<xrd::basis>(), *debye};
   else
     return xrd::crystal{j.at("lattice").get<xrd::lattice>(), j.at("basis").get<xrd::basis>()};
 }
@@ -16,6 +33,9 @@ void nlohmann::adl_serializer<xrd::crystal>::to_json(nlohmann::json& j, const xr
   j["basis"] = c.basis();
   if(c.m_DebyeTemperature)
     j["debye_temperature"] = *c.m_DebyeTemperature;
+  /* the basis is written in full; expanding it again on reading leaves it unchanged */
+  if(c.m_SpaceGroup)
+    j["space_group"] = *c.m_SpaceGroup;
 }
 
 real_t xrd::crystal::debye_temperature() const noexcept {
@@ -5,10 +5,12 @@
 
 #include <nlohmann/json_fwd.hpp>
 
+#include <complex_array.hpp>
 #include <math.hpp>
 
 #include "basis.hpp"
 #include "lattice.hpp"
+#include "space_group.hpp"
 
 #include "tables/form_factor.hpp"
 
@@ -17,8 +19,20 @@ namespace xrd {
     friend struct ::nlohmann::adl_serializer<crystal>;
 
    public:
-    crystal(xrd::lattice l, xrd::basis b) : m_Lattice{std::move(l)}, m_Basis{std::move(b)} {}
-    crystal(xrd::lattice l, xrd::basis b, real_t debye) : m_Lattice{std::move(l)}, m_Basis{std::move(b)}, m_DebyeTemperature{debye} {}
+    crystal(xrd::lattice l, xrd::basis b) : m_Lattice{std::move(l)}, m_Basis{std::move(b)}, m_AtomPositions{atom_positions(m_Lattice, m_Basis)} {}
+    crystal(xrd::lattice l, xrd::basis b, real_t debye)
+        : m_Lattice{std::move(l)}, m_Basis{std::move(b)}, m_AtomPositions{atom_positions(m_Lattice, m_Basis)}, m_DebyeTemperature{debye} {}
+    /// Crystal of a space group: the atoms of the asymmetric unit are expanded to the full cell, and the lattice must be
+    /// the conventional cell of the group.
+    crystal(xrd::lattice l, xrd::space_group g, const xrd::basis& asymmetric_unit)
+        : m_Lattice{std::move(l)}, m_Basis{g.expand(asymmetric_unit)}, m_AtomPositions{atom_positions(m_Lattice, m_Basis)}, m_SpaceGroup{std::move(g)} {
+      m_SpaceGroup->validate(m_Lattice);
+    }
+    crystal(xrd::lattice l, xrd::space_group g, const xrd::basis& asymmetric_unit, real_t debye)
+        : m_Lattice{std::move(l)}, m_Basis{g.expand(asymmetric_unit)}, m_AtomPositions{atom_positions(m_Lattice, m_Basis)}, m_DebyeTemperature{debye},
+          m_SpaceGroup{std::move(g)} {
+      m_SpaceGroup->validate(m_Lattice);
+    }
 
     [[nodiscard]] real_t debye_temperature() const noexcept;
     [[nodiscard]] real_t mass_density() const noexcept {
@@ -28,31 +42,73 @@ namespace xrd {
       return m_Basis.count() / m_Lattice.cell_volume();
     }
     [[nodiscard]] inline cplx_t structure_factor(const rvec3_t& wavevector) const noexcept {
-      return structure_factor(wavevector, [](const basis::atom& atom) { return 1; });
+      return structure_factor(wavevector, [](const basis::atom&) { return 1; });
     }
 
     template <typename F>
     [[nodiscard]] cplx_t structure_factor(const rvec3_t& wavevector, F&& ff_mod) const noexcept {
-      using namespace std::complex_literals;
+      const real_t x = wavevector.norm() / (4 * C_PI);
+
+      real_t f_norm = 0;
+      cplx_t s = 0;
+      sint_t jj = 0;
+      for(const auto& atom : m_Basis) {
+        const cplx_t f = tables::f0(atom.f, x) * ff_mod(atom);
+        f_norm += math::squared_norm(f);
+        s += f * math::exp(-k_i * wavevector.dot(m_AtomPositions.col(jj++)));
+      }
+
+      return s / std::sqrt(f_norm);
+    }
 
-      struct structure {
-        real_t f;
-        cplx_t s;
-      };
+    /// Structure factors of M wavevectors at once (one per column), normalised like the single wavevector version.
+    /// The phases of all atoms are computed as a single (M x atoms) matrix product.
+    inline void structure_factor(const rmatrix_t<3, n_dynamic>& wavevectors, math::complex_array& out) const {
+      structure_factor(wavevectors, [](const basis::atom&) { return 1; }, out);
+    }
 
-      auto x = wavevector.norm()/(4*C_PI);
-      auto [f, s] = std::transform_reduce(
-        m_Basis.begin(), m_Basis.end(), structure{},
-        [](const structure& p1, const structure& p2) -> structure {
-          return {p1.f + p2.f, p1.s + p2.s};
-        },
-        [this, x, &wavevector, &ff_mod](const basis::atom& atom) -> structure {
-          const rvec3_t r = m_Lattice.r3_vector(atom.r);
-          const cplx_t f = tables::f0(atom.f, x) * ff_mod(atom);
-          return {math::squared_norm(f), f * math::exp(-k_i * wavevector.dot(r))};
-        });
+    template <typename F>
+    void structure_factor(const rmatrix_t<3, n_dynamic>& wavevectors, F&& ff_mod, math::complex_array& out) const {
+      const sint_t count = wavevectors.cols();
+
+      const rmat_t phases = wavevectors.transpose() * m_AtomPositions;
+      const rdata_t x = wavevectors.colwise().norm().transpose().array() / (4 * C_PI);
+
+      out = math::complex_array::zero(count);
+      rdata_t f_norm = rdata_t::Zero(count);
+      math::complex_array f(count), e(count);
+      sint_t jj = 0;
+      for(const auto& atom : m_Basis) {
+        const tables::cromer_mann& cm = tables::f0_coefficients(atom.f);
+        const cplx_t mod = ff_mod(atom);
+
+        for(sint_t ii = 0; ii < count; ++ii) {
+          const real_t f0 = tables::f0(cm, x(ii));
+          f.re()(ii) = f0 * mod.re();
+          f.im()(ii) = f0 * mod.im();
+        }
+        f_norm += f.squared_norm();
+
+        math::soa::assign_cis(1, -1, phases.col(jj++).data(), e.re().data(), e.im().data(), count);
+        out.multiply_accumulate(f, e);
+      }
+
+      const rdata_t scale = f_norm.rsqrt();
+      out.re() *= scale;
+      out.im() *= scale;
+    }
 
-      return s / std::sqrt(f);
+    /// |F|^2 of M wavevectors (see the batch structure_factor()).
+    template <typename F>
+    void squared_structure_factor(const rmatrix_t<3, n_dynamic>& wavevectors, F&& ff_mod, rdata_t& out) const {
+      math::complex_array s;
+      structure_factor(wavevectors, std::forward<F>(ff_mod), s);
+      out = s.squared_norm();
+    }
+
+    /// Cartesian positions of the basis atoms, one per column.
+    [[nodiscard]] inline const rmatrix_t<3, n_dynamic>& atom_positions() const noexcept {
+      return m_AtomPositions;
     }
 
     [[nodiscard]] inline const xrd::basis& basis() const noexcept {
@@ -61,11 +117,35 @@ namespace xrd {
     [[nodiscard]] inline const xrd::lattice& lattice() const noexcept {
       return m_Lattice;
     }
+    [[nodiscard]] inline const std::optional<xrd::space_group>& space_group() const noexcept {
+      return m_SpaceGroup;
+    }
+
+    /// Whether reflection hkl is systematically absent in the space group of the crystal, so that it need not be
+    /// evaluated. Always false for crystals given without a space group.
+    [[nodiscard]] inline bool is_absent(const ivec3_t& hkl) const noexcept {
+      return m_SpaceGroup && m_SpaceGroup->is_absent(hkl);
+    }
+    /// Same, for a plane with real indices; planes with non-integer indices are never absent.
+    [[nodiscard]] inline bool is_absent(const rvec3_t& plane) const noexcept {
+      const rvec3_t rounded = plane.array().round();
+      return m_SpaceGroup && (plane - rounded).isZero(1e-9) && m_SpaceGroup->is_absent(rounded.cast<sint_t>());
+    }
 
    private:
+    static rmatrix_t<3, n_dynamic> atom_positions(const xrd::lattice& l, const xrd::basis& b) {
+      rmatrix_t<3, n_dynamic> positions(3, b.count());
+      sint_t jj = 0;
+      for(const auto& atom : b)
+        positions.col(jj++) = l.r3_vector(atom.r);
+      return positions;
+    }
+
     xrd::lattice m_Lattice;
     xrd::basis m_Basis;
+    rmatrix_t<3, n_dynamic> m_AtomPositions;
     std::optional<real_t> m_DebyeTemperature;
+    std::optional<xrd::space_group> m_SpaceGroup;
   };
 }    // namespace xrd
 
@@ -1,32 +1,306 @@
 #include "diffraction.hpp"
 
-#include <gslpp/integration.hpp>
+#include <algorithm>
+#include <numeric>
+#include <optional>
+
 #include <gslpp/spline.hpp>
 
+#include <gsl/gsl_cdf.h>
+
+#include <complex_array.hpp>
 #include <constants.hpp>
 #include <math.hpp>
+#include <math/debye.hpp>
+#include <math/summation.hpp>
+#include <math/vec.hpp>
+#include <simd.hpp>
 
 namespace {
-  real_t temp_dimensionless_phi(real_t x) {
-    real_t d = gsl::integration::qag_adaptive([x](double e) -> double { return e / (std::exp(e) - 1); }, 0, x, gsl::integration::rule::e_Gauss_41, 0, 1e-5);
-    return d / x;
+  real_t temp_dimensionless_phi(real_t x) noexcept {
+    return math::debye::d1(x);
   }
 
-  real_t temp_v2(real_t debye, real_t T) {
+  real_t temp_v2(real_t debye, real_t T, real_t phi_x) noexcept {
     constexpr real_t C1 = 145.526; /*3*hb/k_b in K.Da.A^2 */
 
     const real_t x = debye / T;
-    return C1 * ((temp_dimensionless_phi(x) / x) + 0.25) / debye;
+    return C1 * ((phi_x / x) + 0.25) / debye;
+  }
+
+  /* Evaluates f only on part of the (increasing) grid thetas: every point flagged in dense, every stride-th point, and
+   * then midpoints of the intervals where linear interpolation still misses the midpoint by more than tolerance times the
+   * largest intensity found. The remaining points are linearly interpolated. Returns the number of evaluations. */
+  template <typename F>
+  uint_t adaptive_sweep(const rdata_t& thetas, const stl::vector<bool>& dense, sint_t stride, real_t tolerance, F&& f, rdata_t& intensities) {
+    struct gap {
+      sint_t l, mid, r;
+    };
+
+    const sint_t n = thetas.size();
+    intensities.resize(n);
+    if(n == 0)
+      return 0;
+
+    stl::vector<bool> evaluated(n, false);
+    stl::vector<sint_t> points;
+    for(sint_t ii = 0; ii < n; ++ii)
+      if(dense[ii] || ii % stride == 0 || ii == n - 1)
+        points.push_back(ii);
+
+    auto fn_lerp = [&thetas, &intensities](sint_t l, sint_t r, sint_t ii) -> real_t {
+      const real_t t = (thetas(ii) - thetas(l)) / (thetas(r) - thetas(l));
+      return (1 - t) * intensities(l) + t * intensities(r);
+    };
+
+    uint_t evaluations = 0;
+    stl::vector<gap> gaps;
+    real_t scale = 0;
+    while(!points.empty()) {
+      const sint_t count = points.size();
+#pragma omp parallel for default(none) shared(points, intensities, f, count)
+      for(sint_t kk = 0; kk < count; ++kk)
+        intensities(points[kk]) = f(points[kk]);
+
+      for(sint_t ii : points) {
+        evaluated[ii] = true;
+        scale = std::max(scale, std::abs(intensities(ii)));
+      }
+      evaluations += count;
+
+      /* the first pass splits the grid into gaps; after that, a gap whose midpoint is reproduced by interpolation is
+       * done and the others are bisected again */
+      stl::vector<gap> next;
+      if(evaluations == static_cast<uint_t>(count)) {
+        for(sint_t kk = 1; kk < count; ++kk)
+          if(points[kk] - points[kk - 1] > 1)
+            next.push_back({points[kk - 1], (points[kk - 1] + points[kk]) / 2, points[kk]});
+      } else {
+        for(const auto& g : gaps) {
+          if(std::abs(intensities(g.mid) - fn_lerp(g.l, g.r, g.mid)) <= tolerance * scale)
+            continue;
+          if(g.mid - g.l > 1)
+            next.push_back({g.l, (g.l + g.mid) / 2, g.mid});
+          if(g.r - g.mid > 1)
+            next.push_back({g.mid, (g.mid + g.r) / 2, g.r});
+        }
+      }
+      gaps = std::move(next);
+
+      points.clear();
+      for(const auto& g : gaps)
+        points.push_back(g.mid);
+    }
+
+    for(sint_t ii = 1, prev = 0; ii < n; ++ii) {
+      if(!evaluated[ii])
+        continue;
+      for(sint_t jj = prev + 1; jj < ii; ++jj)
+        intensities(jj) = fn_lerp(prev, ii, jj);
+      prev = ii;
+    }
+
+    return evaluations;
+  }
+
+  /* Sum over the mosaic samples (rows of the projections, see workspace) of geometry factor times |F|^2 at one angle.
+   * Single precision kernels read projections_single, the others projections. The terms of each block are added to
+   * the result with the given summation method. */
+  using mosaic_kernel = real_t (*)(const rmdata_t& projections, const mdata_t<float>& projections_single,
+                                   const std::array<xrd::interference_function, 3>& interference, real_t sin_theta, const real_t* scattering,
+                                   sint_t scattering_stride, math::summation::method summation) noexcept;
+
+  constexpr sint_t k_MosaicBlockSize = 256;
+
+  template <typename T>
+  inline const mdata_t<T>& kernel_projections(const rmdata_t& projections, const mdata_t<float>& projections_single) noexcept {
+    if constexpr(std::is_same_v<T, float>)
+      return projections_single;
+    else
+      return projections;
+  }
+
+  template <typename T>
+  inline T interference_at(const xrd::interference_function& xi, T x) noexcept {
+    if constexpr(std::is_same_v<T, float>)
+      return xi.single(x);
+    else
+      return xi(x);
+  }
+
+  template <typename T>
+  XRD_SIMD_INLINE void geometry_block(const mdata_t<T>& projections, const std::array<xrd::interference_function, 3>& interference, T sin_theta, sint_t b, sint_t n,
+                             T* geometry) noexcept {
+#pragma omp simd
+    for(sint_t ii = 0; ii < n; ++ii)
+      geometry[ii] = 1;
+
+    for(sint_t dd = 0; dd < 3; ++dd) {
+      const T* p = projections.col(dd).data() + b;
+      const T s = sin_theta / 2;
+      const xrd::interference_function& xi = interference[dd];
+
+#pragma omp simd
+      for(sint_t ii = 0; ii < n; ++ii)
+        geometry[ii] *= interference_at(xi, s * p[ii]);
+    }
+  }
+
+  /* any number of atoms: the structure factor is accumulated one atom at a time over a block of samples */
+  template <typename T>
+  XRD_SIMD_INLINE real_t mosaic_sum_generic(const rmdata_t& projections_native, const mdata_t<float>& projections_single,
+                            const std::array<xrd::interference_function, 3>& interference, real_t sin_theta, const real_t* scattering,
+                            sint_t scattering_stride, math::summation::method summation) noexcept {
+    const mdata_t<T>& projections = kernel_projections<T>(projections_native, projections_single);
+    const sint_t atom_count = projections.cols() - 3;
+    const sint_t count = projections.rows();
+
+    alignas(64) T geometry[k_MosaicBlockSize];
+    alignas(64) T s_re[k_MosaicBlockSize];
+    alignas(64) T s_im[k_MosaicBlockSize];
+
+    /* the terms are computed in T, and summed in real_t */
+    math::summation::accumulator<real_t> intensity{summation};
+    for(sint_t b = 0; b < count; b += k_MosaicBlockSize) {
+      const sint_t n = std::min(k_MosaicBlockSize, count - b);
+
+      geometry_block<T>(projections, interference, sin_theta, b, n, geometry);
+
+#pragma omp simd
+      for(sint_t ii = 0; ii < n; ++ii) {
+        s_re[ii] = 0;
+        s_im[ii] = 0;
+      }
+
+      /* structure factor sum_j f_j exp(-i sin(theta) p_j) */
+      for(sint_t jj = 0; jj < atom_count; ++jj)
+        math::soa::accumulate_cis<T>(scattering[jj * scattering_stride], -sin_theta, projections.col(3 + jj).data() + b, s_re, s_im, n);
+
+#pragma omp simd
+      for(sint_t ii = 0; ii < n; ++ii)
+        geometry[ii] *= s_re[ii] * s_re[ii] + s_im[ii] * s_im[ii];
+
+      intensity.add(geometry, n);
+    }
+    return intensity.value();
+  }
+
+  /* N atoms known at compile time: the atom loop is unrolled inside the sample loop, so the structure factor of each
+   * sample stays in registers instead of being accumulated in memory N times */
+  template <sint_t N, typename T>
+  XRD_SIMD_INLINE real_t mosaic_sum_fixed(const rmdata_t& projections_native, const mdata_t<float>& projections_single,
+                          const std::array<xrd::interference_function, 3>& interference, real_t sin_theta_native, const real_t* scattering,
+                          sint_t scattering_stride, math::summation::method summation) noexcept {
+    const mdata_t<T>& projections = kernel_projections<T>(projections_native, projections_single);
+    const sint_t count = projections.rows();
+    const T sin_theta = sin_theta_native;
+
+    std::array<T, N> f;
+    for(sint_t jj = 0; jj < N; ++jj)
+      f[jj] = scattering[jj * scattering_stride];
+
+    alignas(64) T geometry[k_MosaicBlockSize];
+
+    math::summation::accumulator<real_t> intensity{summation};
+    for(sint_t b = 0; b < count; b += k_MosaicBlockSize) {
+      const sint_t n = std::min(k_MosaicBlockSize, count - b);
+
+      geometry_block<T>(projections, interference, sin_theta, b, n, geometry);
+
+      std::array<const T*, N> p;
+      for(sint_t jj = 0; jj < N; ++jj)
+        p[jj] = projections.col(3 + jj).data() + b;
+
+#pragma omp simd
+      for(sint_t ii = 0; ii < n; ++ii) {
+        T s_re = 0, s_im = 0;
+#pragma GCC unroll 8
+        for(sint_t jj = 0; jj < N; ++jj) {
+          T sin_p, cos_p;
+          math::vec::sincos(sin_theta * p[jj][ii], sin_p, cos_p);
+          s_re += f[jj] * cos_p;
+          s_im -= f[jj] * sin_p;
+        }
+        geometry[ii] *= s_re * s_re + s_im * s_im;
+      }
+      intensity.add(geometry, n);
+    }
+    return intensity.value();
+  }
+
+  /* Entry points for each instruction set (see simd.hpp): N atoms, or any number of atoms for N = 0. The kernel bodies
+   * are inlined, so they are compiled for the target of the entry point. */
+#define XRD_MOSAIC_KERNEL_VARIANT(name, target)                                                                                                             \
+  template <sint_t N, typename T>                                                                                                                           \
+  target real_t name(const rmdata_t& projections, const mdata_t<float>& projections_single, const std::array<xrd::interference_function, 3>& interference, \
+                     real_t sin_theta, const real_t* scattering, sint_t scattering_stride, math::summation::method summation) noexcept {                    \
+    if constexpr(N == 0)                                                                                                                                    \
+      return mosaic_sum_generic<T>(projections, projections_single, interference, sin_theta, scattering, scattering_stride, summation);                     \
+    else                                                                                                                                                    \
+      return mosaic_sum_fixed<N, T>(projections, projections_single, interference, sin_theta, scattering, scattering_stride, summation);                   \
+  }
+
+  XRD_MOSAIC_KERNEL_VARIANT(mosaic_sum_baseline, )
+  XRD_MOSAIC_KERNEL_VARIANT(mosaic_sum_avx2, XRD_SIMD_TARGET_AVX2)
+  XRD_MOSAIC_KERNEL_VARIANT(mosaic_sum_avx512, XRD_SIMD_TARGET_AVX512)
+#undef XRD_MOSAIC_KERNEL_VARIANT
+
+  /* fixed size kernels for the small bases we usually simulate, the generic one (index 0) otherwise */
+  constexpr sint_t k_MaxFixedAtoms = 8;
+  using mosaic_kernel_table = std::array<mosaic_kernel, k_MaxFixedAtoms + 1>;
+
+  template <typename T>
+  constexpr std::array<mosaic_kernel_table, simd::k_IsaCount> k_MosaicKernels = []<sint_t... Is>(std::integer_sequence<sint_t, Is...>) {
+    return std::array<mosaic_kernel_table, simd::k_IsaCount>{mosaic_kernel_table{&mosaic_sum_baseline<Is, T>...},
+                                                             mosaic_kernel_table{&mosaic_sum_avx2<Is, T>...},
+                                                             mosaic_kernel_table{&mosaic_sum_avx512<Is, T>...}};
+  }(std::make_integer_sequence<sint_t, k_MaxFixedAtoms + 1>());
+
+  /* The fixed kernels feed sin(theta) * projections of the atoms straight into the scalar math::vec::sincos, which has
+   * no libm fallback. Bases that reach past its reduction range (large supercells) take the generic kernel, whose cis
+   * kernels fall back to libm. */
+  template <typename T>
+  mosaic_kernel select_mosaic_kernel(const rmdata_t& projections) noexcept {
+    const mosaic_kernel_table& kernels = simd::dispatch(k_MosaicKernels<T>);
+    const sint_t atom_count = projections.cols() - 3;
+    const bool fixed = atom_count >= 1 && atom_count <= k_MaxFixedAtoms &&
+                       projections.rightCols(atom_count).abs().maxCoeff() <= math::vec::reduction_limit<T>();
+    return fixed ? kernels[atom_count] : kernels[0];
+  }
+
+  mosaic_kernel select_mosaic_kernel(const rmdata_t& projections, xrd::kernel_precision precision) noexcept {
+    return (precision == xrd::kernel_precision::e_Single) ? select_mosaic_kernel<float>(projections) : select_mosaic_kernel<real_t>(projections);
   }
 }    // namespace
 
 struct xrd::single_plane_diffraction_pattern::workspace {
-  explicit workspace(rmatrix_t<3, Eigen::Dynamic> mosaics, real_t s2, real_t debye, real_t T)
-      : mosaic_planes{std::move(mosaics)}, tan_s2{std::tan(s2)}, x{debye / T}, x_2{x}, phi_x{temp_dimensionless_phi(x)}, c2{phi_x + x / 4}, v2{temp_v2(debye,
-                                                                                                                                                       T)} {}
+  explicit workspace(rmatrix_t<3, Eigen::Dynamic> mosaics, const xrd::crystal& c, const ivector_t<3>& c_size, real_t s2, real_t debye, real_t T,
+                     kernel_precision precision, math::summation::method summation)
+      : mosaic_planes{std::move(mosaics)}, projections{project(mosaic_planes, c)}, projections_single{single(projections, precision)},
+        kernel{select_mosaic_kernel(projections, precision)},
+        interference{interference_function(c_size(0)), interference_function(c_size(1)), interference_function(c_size(2))}, tan_s2{std::tan(s2)},
+        x{debye / T}, x_2{x}, phi_x{temp_dimensionless_phi(x)}, c2{phi_x + x / 4}, v2{temp_v2(debye, T, phi_x)}, precision{precision}, summation{summation} {}
+
+  /* shares the plane-independent tables of another workspace (same crystal and environment) */
+  explicit workspace(rmatrix_t<3, Eigen::Dynamic> mosaics, const xrd::crystal& c, const workspace& shared)
+      : mosaic_planes{std::move(mosaics)}, projections{project(mosaic_planes, c)}, projections_single{single(projections, shared.precision)},
+        kernel{select_mosaic_kernel(projections, shared.precision)}, interference{shared.interference}, tan_s2{shared.tan_s2}, x{shared.x}, x_2{shared.x_2}, phi_x{shared.phi_x},
+        c2{shared.c2}, v2{shared.v2}, precision{shared.precision}, summation{shared.summation} {}
 
   const rmatrix_t<3, Eigen::Dynamic> mosaic_planes;
 
+  /* projections of each mosaic sample onto the lattice vectors (columns 0-2) and onto the atom positions (one column per
+   * basis atom), so that for an angle theta the phases are just sin(theta) * projections */
+  const rmdata_t projections;
+  /* single precision copy of the projections, only filled for kernel_precision::e_Single */
+  const mdata_t<float> projections_single;
+
+  /* mosaic loop, specialised on the number of basis atoms and the precision (see select_mosaic_kernel) */
+  const mosaic_kernel kernel;
+
+  /* tabulated interference functions along each lattice vector */
+  const std::array<interference_function, 3> interference;
+
   const real_t tan_s2;
 
   const real_t x;
@@ -35,9 +309,36 @@ struct xrd::single_plane_diffraction_pattern::workspace {
   const real_t c2;
 
   const real_t v2;
+
+  const kernel_precision precision;
+  const math::summation::method summation;
+
+ private:
+  static mdata_t<float> single(const rmdata_t& projections, kernel_precision precision) {
+    return (precision == kernel_precision::e_Single) ? mdata_t<float>(projections.cast<float>()) : mdata_t<float>();
+  }
+
+  static rmdata_t project(const rmatrix_t<3, Eigen::Dynamic>& mosaics, const xrd::crystal& c) {
+    rmatrix_t<3, n_dynamic> targets(3, 3 + c.basis().count());
+    targets.leftCols<3>() = c.lattice().basis_matrix();
+    targets.rightCols(c.basis().count()) = c.atom_positions();
+
+    return (mosaics.transpose() * targets).array();
+  }
 };
 
-real_t xrd::single_plane_diffraction_pattern::calculate_intensity_internal(const xrd::single_plane_diffraction_pattern::workspace& w, real_t theta) const {
+/* quantities that only depend on the scattering angle, tabulated once per angle grid */
+struct xrd::single_plane_diffraction_pattern::angle_factors {
+  rdata_t sin_theta;
+
+  /* Lorentz, polarisation and absorption factors, divided by the sum of the squared scattering amplitudes */
+  rdata_t prefactor;
+
+  /* scattering amplitude (form factor times Debye-Waller factor) of each basis atom (angles x atoms) */
+  rmdata_t scattering;
+};
+
+real_t xrd::single_plane_diffraction_pattern::calculate_intensity_reference(const xrd::single_plane_diffraction_pattern::workspace& w, real_t theta) const {
   const real_t sin_theta = std::sin(theta);
   const real_t csc_theta = 1 / sin_theta;
   const real_t cos_theta = std::cos(theta);
@@ -53,7 +354,7 @@ real_t xrd::single_plane_diffraction_pattern::calculate_intensity_internal(const
   const real_t f_lorentz = 1 / (2 * sin_theta * sin_2theta);
   const real_t f_polarization = (1 + cos_2theta * cos_2theta) / 2;
 
-  real_t intensity = 0;
+  math::summation::accumulator<real_t> intensity{w.summation};
   for(sint_t ii = 0; ii < w.mosaic_planes.cols(); ++ii) {
     const rvec3_t delta_k = w.mosaic_planes.col(ii) * sin_theta;
 
@@ -63,50 +364,223 @@ real_t xrd::single_plane_diffraction_pattern::calculate_intensity_internal(const
 
     intensity += math::squared_norm(m_Crystal.structure_factor(delta_k, fn_f)) * factors;
   }
-  return intensity / w.mosaic_planes.cols();
+  return intensity.value() / w.mosaic_planes.cols();
+}
+
+real_t xrd::single_plane_diffraction_pattern::calculate_intensity_vectorised(const xrd::single_plane_diffraction_pattern::workspace& w,
+                                                                            const xrd::single_plane_diffraction_pattern::angle_factors& af, sint_t index) const {
+  return calculate_intensity_vectorised(w, af.sin_theta(index), af.prefactor(index), &af.scattering(index, 0), af.scattering.rows());
+}
+
+real_t xrd::single_plane_diffraction_pattern::calculate_intensity_vectorised(const xrd::single_plane_diffraction_pattern::workspace& w, real_t sin_theta,
+                                                                            real_t prefactor, const real_t* scattering, sint_t scattering_stride) const {
+  return w.kernel(w.projections, w.projections_single, w.interference, sin_theta, scattering, scattering_stride, w.summation) * prefactor /
+         w.projections.rows();
+}
+
+real_t xrd::single_plane_diffraction_pattern::calculate_scattering(const xrd::single_plane_diffraction_pattern::workspace& w, real_t theta,
+                                                                  real_t* scattering) const {
+  real_t sin_theta, cos_theta, sin_2theta, cos_2theta;
+  math::vec::sincos(theta, sin_theta, cos_theta);
+  math::vec::sincos(2 * theta, sin_2theta, cos_2theta);
+
+  const real_t f_abs = 1 - math::vec::exp(-2 * m_AbsorptionUT / sin_theta);
+
+  const real_t f_lorentz = 1 / (2 * sin_theta * sin_2theta);
+  const real_t f_polarization = (1 + cos_2theta * cos_2theta) / 2;
+
+  const real_t x = sin_theta / m_XrayWavelength;
+  const real_t dw_exponent = -8 * C_PI * C_PI * w.v2 * x * x;
+
+  real_t norm = 0;
+  sint_t jj = 0;
+  for(const auto& atom : m_Crystal.basis()) {
+    scattering[jj] = tables::f0(atom.f, x) * math::vec::exp(dw_exponent / atom.m);
+    norm += scattering[jj] * scattering[jj];
+    ++jj;
+  }
+
+  return f_lorentz * f_polarization * f_abs / norm;
+}
+
+auto xrd::single_plane_diffraction_pattern::calculate_angle_factors(const xrd::single_plane_diffraction_pattern::workspace& w, const rdata_t& thetas) const
+  -> angle_factors {
+  angle_factors af;
+
+  af.sin_theta = math::vec::sin(thetas);
+  const rdata_t sin_2theta = math::vec::sin(2 * thetas);
+  const rdata_t cos_2theta = math::vec::cos(2 * thetas);
+
+  const rdata_t f_abs = 1 - math::vec::exp(-2 * m_AbsorptionUT / af.sin_theta);
+
+  const rdata_t f_lorentz = 1 / (2 * af.sin_theta * sin_2theta);
+  const rdata_t f_polarization = (1 + cos_2theta.square()) / 2;
+
+  /* every delta_k in the mosaic set has the same norm, so the atomic scattering factors only depend on the angle */
+  const rdata_t x = af.sin_theta / m_XrayWavelength;
+  const rdata_t dw_exponent = (-8 * C_PI * C_PI * w.v2) * x.square();
+
+  /* form factors are tabulated once per species, not once per atom */
+  stl::vector<uint_t> species;
+  for(const auto& atom : m_Crystal.basis())
+    if(std::find(species.begin(), species.end(), atom.f) == species.end())
+      species.push_back(atom.f);
+
+  rmdata_t f0;
+  tables::f0(species, std::span<const real_t>(x.data(), x.size()), f0);
+
+  af.scattering.resize(thetas.size(), m_Crystal.basis().count());
+  {
+    sint_t jj = 0;
+    for(const auto& atom : m_Crystal.basis()) {
+      const sint_t s = std::distance(species.begin(), std::find(species.begin(), species.end(), atom.f));
+      af.scattering.col(jj++) = f0.col(s) * math::vec::exp(dw_exponent / atom.m);
+    }
+  }
+
+  af.prefactor = f_lorentz * f_polarization * f_abs / af.scattering.square().rowwise().sum();
+
+  return af;
+}
+
+void xrd::single_plane_diffraction_pattern::calculate_intensities(const xrd::single_plane_diffraction_pattern::workspace& w, const rdata_t& thetas,
+                                                                  rdata_t& intensities) const {
+  intensities.resize(thetas.size());
+
+  switch(m_Kernel) {
+    case kernel_type::e_Reference: {
+#pragma omp parallel for default(none) shared(w, thetas, intensities)
+      for(sint_t ii = 0; ii < intensities.size(); ++ii)
+        intensities(ii) = calculate_intensity_reference(w, thetas(ii));
+      break;
+    }
+    default:
+    case kernel_type::e_Vectorised: {
+      const angle_factors af = calculate_angle_factors(w, thetas);
+#pragma omp parallel for default(none) shared(w, af, intensities)
+      for(sint_t ii = 0; ii < intensities.size(); ++ii)
+        intensities(ii) = calculate_intensity_vectorised(w, af, ii);
+      break;
+    }
+  }
 }
 
 real_t xrd::single_plane_diffraction_pattern::calculate_intensity_with_mosaic(rmatrix_t<3, n_dynamic> mosaic_planes, real_t theta) const {
-  workspace w{std::move(mosaic_planes), m_ReceivingSollerSlitAngle, m_Crystal.debye_temperature(), m_Temperature};
-  return calculate_intensity_internal(w, theta);
+  return diffraction_plan{*this, std::move(mosaic_planes)}.execute_at(theta);
+}
+
+xrd::diffraction_plan xrd::single_plane_diffraction_pattern::plan() const {
+  return diffraction_plan{*this};
 }
 
 void xrd::single_plane_diffraction_pattern::generate(const rdata_t& angles, rdata_t& intensities) const {
-  intensities.resize(angles.size());
+  workspace w{generate_random_scattering_vectors(), m_Crystal, m_CrystalliteSize, m_ReceivingSollerSlitAngle, m_Crystal.debye_temperature(), m_Temperature, m_Precision, m_Summation};
+  calculate_intensities(w, angles.unaryExpr(&math::deg2rad), intensities);
+}
 
-  workspace w{generate_random_scattering_vectors(), m_ReceivingSollerSlitAngle, m_Crystal.debye_temperature(), m_Temperature};
-#pragma omp parallel for default(none) shared(w, angles, intensities)
-  for(sint_t ii = 0; ii < intensities.size(); ++ii)
-    intensities(ii) = calculate_intensity_internal(w, math::deg2rad(angles(ii)));
+void xrd::single_plane_diffraction_pattern::generate_with_mosaic(const rdata_t& angles, const rmatrix_t<3, n_dynamic>& local_mosaics,
+                                                                 rdata_t& intensities) const {
+  workspace w{orient_mosaic_set(local_mosaics), m_Crystal, m_CrystalliteSize, m_ReceivingSollerSlitAngle, m_Crystal.debye_temperature(), m_Temperature, m_Precision, m_Summation};
+  calculate_intensities(w, angles.unaryExpr(&math::deg2rad), intensities);
 }
 
-rmatrix_t<3, n_dynamic> xrd::single_plane_diffraction_pattern::generate_random_scattering_vectors() const {
-  real_t magnitude = (2 * (2 * C_PI / m_XrayWavelength));
-  if(m_MosaicSamples == 0 || m_MosaicSpread == 0) {
-    return magnitude * m_ReciprocalLattice.r3_vector(m_Plane).normalized();
-  } else {
-    rmatrix_t<3, n_dynamic> vectors(3, m_MosaicSamples);
+uint_t xrd::single_plane_diffraction_pattern::generate_adaptive(const rdata_t& angles, rdata_t& intensities, const adaptive_grid& grid) const {
+  workspace w{generate_random_scattering_vectors(), m_Crystal, m_CrystalliteSize, m_ReceivingSollerSlitAngle, m_Crystal.debye_temperature(), m_Temperature, m_Precision, m_Summation};
+  const rdata_t thetas = angles.unaryExpr(&math::deg2rad);
 
-    const rvec3_t g = m_ReciprocalLattice.r3_vector(m_Plane);
-    rmatrix_t<3, 3> basis = math::linalg::generate_orthonormal_basis_from_vector(g.normalized());
+  if(m_Kernel == kernel_type::e_Reference)
+    return calculate_intensities_adaptive(w, nullptr, thetas, grid, intensities);
 
-    auto fn_rotate = [&basis](real_t phi, real_t theta) noexcept -> rvec3_t {
-      const real_t sin_theta = std::sin(theta);
+  const angle_factors af = calculate_angle_factors(w, thetas);
+  return calculate_intensities_adaptive(w, &af, thetas, grid, intensities);
+}
 
-      const rvec3_t v{std::cos(phi) * sin_theta, std::sin(phi) * sin_theta, std::cos(theta)};
+uint_t xrd::single_plane_diffraction_pattern::calculate_intensities_adaptive(const xrd::single_plane_diffraction_pattern::workspace& w,
+                                                                             const xrd::single_plane_diffraction_pattern::angle_factors* af,
+                                                                             const rdata_t& thetas, const adaptive_grid& grid, rdata_t& intensities) const {
+  if(grid.stride < 1)
+    throw std::invalid_argument(fmt::format("invalid adaptive grid stride ({}): must be at least 1", grid.stride));
+  for(sint_t ii = 1; ii < thetas.size(); ++ii)
+    if(thetas(ii) <= thetas(ii - 1))
+      throw std::invalid_argument("adaptive grid angles must be increasing");
 
-      return basis * v;
-    };
+  const stl::vector<bool> dense = predict_peak_regions(thetas, grid.peak_widths);
 
-    std::uniform_real_distribution<real_t> phi_dist{0, 2 * C_PI};
-    std::normal_distribution<real_t> theta_dist{0, m_MosaicSpread};
-    for(sint_t ii = 0; ii < vectors.cols(); ++ii) {
-      real_t phi = phi_dist(math::rand::tl_Generator), theta = theta_dist(math::rand::tl_Generator);
-      vectors.col(ii) = fn_rotate(phi, std::abs(theta));
-    }
+  if(af == nullptr)
+    return adaptive_sweep(
+      thetas, dense, grid.stride, grid.tolerance, [this, &w, &thetas](sint_t ii) { return calculate_intensity_reference(w, thetas(ii)); }, intensities);
+  else
+    return adaptive_sweep(
+      thetas, dense, grid.stride, grid.tolerance, [this, &w, af](sint_t ii) { return calculate_intensity_vectorised(w, *af, ii); }, intensities);
+}
 
-    return magnitude * vectors;
+stl::vector<bool> xrd::single_plane_diffraction_pattern::predict_peak_regions(const rdata_t& thetas, real_t peak_widths) const {
+  stl::vector<bool> dense(thetas.size(), false);
+  if(thetas.size() == 0)
+    return dense;
+
+  /* delta_k = 2 k sin(theta) along (a mosaic tilt of) the plane normal g, so the Bragg peaks sit where |delta_k| = n |g| */
+  const rvec3_t g = m_ReciprocalLattice.r3_vector(m_Plane);
+  const real_t g_norm = g.norm();
+  const rvec3_t g_hat = g / g_norm;
+  const real_t two_k = 2 * (2 * C_PI / m_XrayWavelength);
+
+  /* the interference function along lattice vector a has its main lobe within 2 pi / (N |g_hat . a|) of the peak; the
+   * narrowest of the three limits the width of the peak */
+  real_t lobe = 0;
+  for(sint_t dd = 0; dd < 3; ++dd)
+    lobe = std::max(lobe, m_CrystalliteSize(dd) * std::abs(g_hat.dot(m_Crystal.lattice().basis_matrix().col(dd))));
+  const real_t half_width = peak_widths * 2 * C_PI / lobe;
+
+  /* mosaic blocks tilted by alpha reach the same reciprocal lattice point at |delta_k| = n |g| / cos(alpha) */
+  const real_t tilt = (m_MosaicSamples == 0) ? 0 : std::min<real_t>(3 * m_MosaicSpread, C_PI / 4);
+
+  const rdata_t delta_k = two_k * thetas.sin();
+  const real_t delta_k_max = delta_k.maxCoeff();
+  for(sint_t n = 0; n * g_norm - half_width <= delta_k_max; ++n) {
+    const real_t lo = n * g_norm - half_width, hi = n * g_norm / std::cos(tilt) + half_width;
+    for(sint_t ii = 0; ii < delta_k.size(); ++ii)
+      if(delta_k(ii) >= lo && delta_k(ii) <= hi)
+        dense[ii] = true;
+  }
+
+  return dense;
+}
+
+rmatrix_t<3, n_dynamic> xrd::single_plane_diffraction_pattern::generate_random_scattering_vectors() const {
+  return orient_mosaic_set(local_mosaic_set(m_MosaicSampling, m_MosaicSamples, m_MosaicSpread, m_Seed));
+}
+
+rmatrix_t<3, n_dynamic> xrd::single_plane_diffraction_pattern::local_mosaic_set(math::sampling::method sampling, uint_t count, real_t spread,
+                                                                              std::uint64_t seed) {
+  if(count == 0 || spread == 0)
+    return rvec3_t::UnitZ();
+
+  rmatrix_t<3, n_dynamic> vectors(3, count);
+
+  /* phi is uniform and theta is the absolute value of a normal deviate, i.e. half-normal with inverse CDF
+   * sigma * Phi^-1((1 + u) / 2) */
+  const rmatrix_t<2, n_dynamic> points = math::sampling::unit_square(sampling, count, seed);
+#pragma omp parallel for default(none) shared(vectors, points, spread)
+  for(sint_t ii = 0; ii < vectors.cols(); ++ii) {
+    const real_t phi = 2 * C_PI * points(0, ii), theta = spread * gsl_cdf_ugaussian_Pinv((1 + points(1, ii)) / 2);
+
+    real_t sin_phi, cos_phi, sin_theta, cos_theta;
+    math::vec::sincos(phi, sin_phi, cos_phi);
+    math::vec::sincos(theta, sin_theta, cos_theta);
+    vectors.col(ii) = rvec3_t{cos_phi * sin_theta, sin_phi * sin_theta, cos_theta};
   }
+
+  return vectors;
+}
+
+rmatrix_t<3, n_dynamic> xrd::single_plane_diffraction_pattern::orient_mosaic_set(const rmatrix_t<3, n_dynamic>& local_mosaics) const {
+  const real_t magnitude = 2 * (2 * C_PI / m_XrayWavelength);
+
+  const rvec3_t g = m_ReciprocalLattice.r3_vector(m_Plane);
+  const rmatrix_t<3, 3> basis = math::linalg::generate_orthonormal_basis_from_vector(g.normalized());
+
+  return magnitude * (basis * local_mosaics);
 }
 
 real_t xrd::powder_grain_distribution_factor(real_t a, real_t sigma) noexcept {
@@ -114,3 +588,323 @@ real_t xrd::powder_grain_distribution_factor(real_t a, real_t sigma) noexcept {
   return a;
   //  return math::erf(a/(C_SQRT2*sigma));
 }
+
+xrd::multi_plane_diffraction_pattern::multi_plane_diffraction_pattern(xrd::crystal c, ivector_t<3> c_size, real_t m_spread, uint_t m_samples,
+                                                                     std::span<const reflection> reflections, real_t temp, real_t wavelength, real_t rec_slit,
+                                                                     kernel_type kernel, math::sampling::method sampling, std::uint64_t seed,
+                                                                     kernel_precision precision, math::summation::method summation) {
+  if(reflections.empty())
+    throw std::invalid_argument("no reflections given");
+
+  m_Patterns.reserve(reflections.size());
+  m_Multiplicities.reserve(reflections.size());
+  /* every plane gets its own, independent stream */
+  for(const auto& r : reflections) {
+    m_Patterns.emplace_back(c, c_size, m_spread, m_samples, r.plane, temp, wavelength, rec_slit, kernel, sampling, math::rand::derive_key(seed, m_Patterns.size()),
+                            precision, summation);
+    m_Multiplicities.push_back(r.multiplicity);
+  }
+}
+
+auto xrd::multi_plane_diffraction_pattern::build_workspaces() const -> stl::vector<single_plane_diffraction_pattern::workspace> {
+  using workspace = single_plane_diffraction_pattern::workspace;
+
+  const auto& p0 = m_Patterns.front();
+
+  /* the Debye-Waller constants and interference tables are computed once and shared by every plane */
+  stl::vector<workspace> ws;
+  ws.reserve(m_Patterns.size());
+  ws.emplace_back(p0.generate_random_scattering_vectors(), p0.m_Crystal, p0.m_CrystalliteSize, p0.m_ReceivingSollerSlitAngle, p0.m_Crystal.debye_temperature(),
+                  p0.m_Temperature, p0.m_Precision, p0.m_Summation);
+  for(sint_t kk = 1; kk < static_cast<sint_t>(m_Patterns.size()); ++kk)
+    ws.emplace_back(m_Patterns[kk].generate_random_scattering_vectors(), m_Patterns[kk].m_Crystal, ws.front());
+  return ws;
+}
+
+void xrd::multi_plane_diffraction_pattern::generate(const rdata_t& angles, rdata_t& intensities) const {
+  rmdata_t plane_intensities;
+  generate(angles, intensities, plane_intensities);
+}
+
+void xrd::multi_plane_diffraction_pattern::generate(const rdata_t& angles, rdata_t& intensities, rmdata_t& plane_intensities) const {
+  using workspace = single_plane_diffraction_pattern::workspace;
+  using angle_factors = single_plane_diffraction_pattern::angle_factors;
+
+  const auto& p0 = m_Patterns.front();
+  const sint_t plane_count = m_Patterns.size();
+
+  const stl::vector<workspace> ws = build_workspaces();
+
+  const rdata_t thetas = angles.unaryExpr(&math::deg2rad);
+
+  intensities.resize(thetas.size());
+  plane_intensities.resize(thetas.size(), plane_count);
+
+  if(p0.m_Kernel == kernel_type::e_Reference) {
+#pragma omp parallel for default(none) shared(ws, thetas, plane_intensities, plane_count)
+    for(sint_t ii = 0; ii < thetas.size(); ++ii)
+      for(sint_t kk = 0; kk < plane_count; ++kk)
+        plane_intensities(ii, kk) = m_Patterns[kk].calculate_intensity_reference(ws[kk], thetas(ii));
+  } else {
+    /* angle factors do not depend on the plane */
+    const angle_factors af = p0.calculate_angle_factors(ws.front(), thetas);
+#pragma omp parallel for default(none) shared(ws, af, thetas, plane_intensities, plane_count)
+    for(sint_t ii = 0; ii < thetas.size(); ++ii)
+      for(sint_t kk = 0; kk < plane_count; ++kk)
+        plane_intensities(ii, kk) = m_Patterns[kk].calculate_intensity_vectorised(ws[kk], af, ii);
+  }
+
+  sum_planes(plane_intensities, intensities);
+}
+
+void xrd::multi_plane_diffraction_pattern::sum_planes(const rmdata_t& plane_intensities, rdata_t& intensities) const {
+  const math::summation::method summation = m_Patterns.front().m_Summation;
+
+  intensities.resize(plane_intensities.rows());
+#pragma omp parallel for default(none) shared(plane_intensities, intensities, summation)
+  for(sint_t ii = 0; ii < intensities.size(); ++ii) {
+    math::summation::accumulator<real_t> intensity{summation};
+    for(sint_t kk = 0; kk < plane_intensities.cols(); ++kk)
+      intensity += m_Multiplicities[kk] * plane_intensities(ii, kk);
+    intensities(ii) = intensity.value();
+  }
+}
+
+uint_t xrd::multi_plane_diffraction_pattern::generate_adaptive(const rdata_t& angles, rdata_t& intensities, rmdata_t& plane_intensities,
+                                                               const adaptive_grid& grid) const {
+  using workspace = single_plane_diffraction_pattern::workspace;
+  using angle_factors = single_plane_diffraction_pattern::angle_factors;
+
+  const auto& p0 = m_Patterns.front();
+  const sint_t plane_count = m_Patterns.size();
+
+  const stl::vector<workspace> ws = build_workspaces();
+
+  const rdata_t thetas = angles.unaryExpr(&math::deg2rad);
+
+  std::optional<angle_factors> af;
+  if(p0.m_Kernel != kernel_type::e_Reference)
+    af = p0.calculate_angle_factors(ws.front(), thetas);
+
+  /* each plane has its own peaks, so each is refined on its own */
+  uint_t evaluations = 0;
+  plane_intensities.resize(thetas.size(), plane_count);
+  rdata_t plane_pattern;
+  for(sint_t kk = 0; kk < plane_count; ++kk) {
+    evaluations += m_Patterns[kk].calculate_intensities_adaptive(ws[kk], af ? &(*af) : nullptr, thetas, grid, plane_pattern);
+    plane_intensities.col(kk) = plane_pattern;
+  }
+
+  sum_planes(plane_intensities, intensities);
+  return evaluations;
+}
+
+xrd::profile_diffraction_pattern::profile_diffraction_pattern(xrd::crystal c, ivector_t<3> c_size,
+                                                               std::span<const multi_plane_diffraction_pattern::reflection> reflections, real_t temp,
+                                                               real_t wavelength, peak_profile profile)
+    : m_Crystal{std::move(c)}, m_ReciprocalLattice{m_Crystal.lattice().reciprocal()}, m_CrystalliteSize{std::move(c_size)},
+      m_Reflections(reflections.begin(), reflections.end()), m_Temperature{temp}, m_XrayWavelength{wavelength}, m_Profile{profile} {
+  if(m_Reflections.empty())
+    throw std::invalid_argument("no reflections given");
+  if(!(m_Profile.eta >= 0 && m_Profile.eta <= 1))
+    throw std::invalid_argument(fmt::format("invalid pseudo-Voigt mixing ({}): must be in [0, 1]", m_Profile.eta));
+  if(!(m_Profile.window > 0))
+    throw std::invalid_argument(fmt::format("invalid peak window ({}): must be positive", m_Profile.window));
+}
+
+auto xrd::profile_diffraction_pattern::peaks(real_t theta_min, real_t theta_max) const -> stl::vector<peak> {
+  const real_t two_k = 2 * (2 * C_PI / m_XrayWavelength);
+  const real_t sin_min = std::sin(math::deg2rad(std::max<real_t>(theta_min, 0)));
+  const real_t sin_max = std::sin(math::deg2rad(std::min<real_t>(theta_max, 90)));
+
+  const real_t debye = m_Crystal.debye_temperature();
+  const real_t v2 = temp_v2(debye, m_Temperature, temp_dimensionless_phi(debye / m_Temperature));
+
+  stl::vector<peak> result;
+  for(sint_t kk = 0; kk < static_cast<sint_t>(m_Reflections.size()); ++kk) {
+    const rvec3_t g = m_ReciprocalLattice.r3_vector(m_Reflections[kk].plane);
+    const real_t g_norm = g.norm();
+    const rvec3_t g_hat = g / g_norm;
+
+    /* along the plane normal the three interference lobes narrow the peak together; with Gaussian lobes their inverse
+     * widths add in quadrature, so the effective thickness is the norm of N_d (g_hat . a_d) */
+    const real_t thickness =
+        (m_CrystalliteSize.cast<real_t>().array() * (m_Crystal.lattice().basis_matrix().transpose() * g_hat).array()).matrix().norm();
+
+    /* |delta_k| = 2 k sin(theta) = n |g| */
+    for(sint_t n = std::max<sint_t>(1, static_cast<sint_t>(std::ceil(two_k * sin_min / g_norm))); n * g_norm <= two_k * sin_max; ++n) {
+      /* systematic absences of the space group are known without evaluating F */
+      if(m_Crystal.is_absent(rvec3_t(n * m_Reflections[kk].plane)))
+        continue;
+
+      const real_t sin_theta = n * g_norm / two_k;
+      const real_t cos_theta = std::sqrt(1 - sin_theta * sin_theta);
+      if(cos_theta <= 0)
+        continue;
+      const real_t theta = std::asin(sin_theta);
+
+      const real_t x = sin_theta / m_XrayWavelength;
+      const real_t dw_exponent = -8 * C_PI * C_PI * v2 * x * x;
+      const real_t f_structure =
+          math::squared_norm(m_Crystal.structure_factor(real_t(n) * g, [dw_exponent](const xrd::basis::atom& a) -> real_t { return math::vec::exp(dw_exponent / a.m); }));
+      const real_t f_abs = 1 - math::vec::exp(-2 * m_AbsorptionUT / sin_theta);
+
+      const real_t fwhm = math::rad2deg(m_Profile.scherrer_constant * m_XrayWavelength / (2 * thickness * cos_theta));
+      result.push_back({math::rad2deg(theta), fwhm, f_structure * lorentz_factor(theta) * polarization_factor(theta) * f_abs, kk, n});
+    }
+  }
+
+  return result;
+}
+
+void xrd::profile_diffraction_pattern::render(const peak& p, real_t scale, const rdata_t& angles, real_t* intensities) const {
+  const real_t* first = angles.data();
+  const real_t* last = first + angles.size();
+  const sint_t lo = std::lower_bound(first, last, p.theta - m_Profile.window * p.fwhm) - first;
+  const sint_t hi = std::upper_bound(first, last, p.theta + m_Profile.window * p.fwhm) - first;
+
+  /* unit-area Gaussian and Lorentzian of the same FWHM; only 2/pi atan(2 window) of the Lorentzian's area is inside the
+   * window, so it is scaled up by the inverse */
+  const real_t eta = m_Profile.eta;
+  const real_t g_scale = scale * (1 - eta) * 2 * std::sqrt(C_LN2 / C_PI) / p.fwhm;
+  const real_t g_exponent = -4 * C_LN2 / (p.fwhm * p.fwhm);
+  const real_t l_scale = scale * eta / (p.fwhm * std::atan(2 * m_Profile.window));
+  const real_t l_width = 4 / (p.fwhm * p.fwhm);
+
+#pragma omp simd
+  for(sint_t ii = lo; ii < hi; ++ii) {
+    const real_t dx2 = (first[ii] - p.theta) * (first[ii] - p.theta);
+    intensities[ii] += g_scale * math::vec::exp(g_exponent * dx2) + l_scale / (1 + l_width * dx2);
+  }
+}
+
+void xrd::profile_diffraction_pattern::generate(const rdata_t& angles, rdata_t& intensities) const {
+  rmdata_t plane_intensities;
+  generate(angles, intensities, plane_intensities);
+}
+
+void xrd::profile_diffraction_pattern::generate(const rdata_t& angles, rdata_t& intensities, rmdata_t& plane_intensities) const {
+  for(sint_t ii = 1; ii < angles.size(); ++ii)
+    if(angles(ii) <= angles(ii - 1))
+      throw std::invalid_argument("profile pattern angles must be increasing");
+
+  const sint_t plane_count = m_Reflections.size();
+  plane_intensities = rmdata_t::Zero(angles.size(), plane_count);
+  intensities.resize(angles.size());
+  if(angles.size() == 0)
+    return;
+
+  /* peaks just outside the grid still reach into it with their tails, so every Bragg angle is taken; the windows clip
+   * them to the grid */
+  for(const peak& p : peaks(0, 90))
+    render(p, p.intensity, angles, plane_intensities.col(p.reflection).data());
+
+  rdata_t weights(plane_count);
+  for(sint_t kk = 0; kk < plane_count; ++kk)
+    weights(kk) = m_Reflections[kk].multiplicity;
+  intensities = (plane_intensities.matrix() * weights.matrix()).array();
+}
+
+xrd::bragg_peak_predictor::bragg_peak_predictor(ivector_t<3> c_size, rvec3_t plane, real_t temp, real_t wavelength)
+    : m_CrystalliteSize{std::move(c_size)}, m_Plane{std::move(plane)}, m_Direction{m_Plane}, m_Temperature{temp}, m_XrayWavelength{wavelength} {
+  if(m_Plane.isZero())
+    throw std::invalid_argument("invalid plane for the peak predictor: (0, 0, 0)");
+
+  /* the single plane pattern of (200) also shows (100), so orders are counted along the primitive direction */
+  const ivec3_t h = m_Plane.array().round().cast<sint_t>();
+  if((h.cast<real_t>() - m_Plane).isZero())
+    m_Direction = (h / std::gcd(std::gcd(h(0), h(1)), h(2))).cast<real_t>();
+}
+
+auto xrd::bragg_peak_predictor::bragg_peaks(const crystal& c, real_t theta_min, real_t theta_max) const -> stl::vector<profile_diffraction_pattern::peak> {
+  const multi_plane_diffraction_pattern::reflection r{m_Direction, 1};
+  return profile_diffraction_pattern(c, m_CrystalliteSize, std::span(&r, 1), m_Temperature, m_XrayWavelength).peaks(theta_min, theta_max);
+}
+
+auto xrd::bragg_peak_predictor::predict(const crystal& c, real_t theta_min, real_t theta_max) const -> stl::vector<peak> {
+  /* a shift may move a peak across either end of the range */
+  real_t margin = 0;
+  for(real_t s : m_Shifts)
+    margin = std::max(margin, std::abs(s));
+
+  const auto bragg = bragg_peaks(c, theta_min - margin, theta_max + margin);
+  real_t max_intensity = 0;
+  for(const auto& p : bragg)
+    max_intensity = std::max(max_intensity, p.intensity);
+
+  stl::vector<peak> result;
+  for(const auto& p : bragg) {
+    if(p.intensity <= 1e-6 * max_intensity)
+      continue;
+
+    const real_t theta = p.theta + (p.order <= static_cast<sint_t>(m_Shifts.size()) ? m_Shifts[p.order - 1] : 0);
+    if(theta >= theta_min && theta <= theta_max)
+      result.push_back({theta, p.intensity, p.order});
+  }
+
+  return result;
+}
+
+void xrd::bragg_peak_predictor::calibrate(const crystal& c, const rdata_t& angles, const rdata_t& intensities) {
+  if(angles.size() != intensities.size())
+    throw std::invalid_argument(fmt::format("angles and intensities differ in size ({0} and {1})", angles.size(), intensities.size()));
+
+  m_Shifts.clear();
+  if(angles.size() < 3)
+    return;
+
+  const std::span<const real_t> x(angles.data(), angles.size()), y(intensities.data(), intensities.size());
+  for(const auto& p : bragg_peaks(c, angles(0), angles(angles.size() - 1))) {
+    const sint_t lo = std::lower_bound(x.begin(), x.end(), p.theta - p.fwhm) - x.begin();
+    const sint_t hi = std::upper_bound(x.begin(), x.end(), p.theta + p.fwhm) - x.begin();
+    if(hi - lo < 3)
+      continue;
+
+    /* a maximum at the edge of the window belongs to a neighbouring peak or a rising tail */
+    const sint_t top = std::max_element(y.begin() + lo, y.begin() + hi) - y.begin();
+    if(top == lo || top == hi - 1)
+      continue;
+
+    if(static_cast<sint_t>(m_Shifts.size()) < p.order)
+      m_Shifts.resize(p.order, 0);
+    m_Shifts[p.order - 1] = math::refine_peak_position(x, y, top) - p.theta;
+  }
+}
+
+xrd::diffraction_plan::diffraction_plan(xrd::single_plane_diffraction_pattern pattern)
+    : diffraction_plan{pattern, pattern.generate_random_scattering_vectors()} {}
+
+xrd::diffraction_plan::diffraction_plan(xrd::single_plane_diffraction_pattern pattern, rmatrix_t<3, n_dynamic> mosaic_planes)
+    : m_Pattern{std::move(pattern)},
+      mp_Workspace{std::make_unique<const single_plane_diffraction_pattern::workspace>(std::move(mosaic_planes), m_Pattern.m_Crystal, m_Pattern.m_CrystalliteSize,
+                                                                                       m_Pattern.m_ReceivingSollerSlitAngle, m_Pattern.m_Crystal.debye_temperature(),
+                                                                                       m_Pattern.m_Temperature, m_Pattern.m_Precision,
+                                                                                       m_Pattern.m_Summation)} {}
+
+xrd::diffraction_plan::diffraction_plan(xrd::diffraction_plan&&) noexcept = default;
+
+xrd::diffraction_plan::~diffraction_plan() = default;
+
+xrd::diffraction_plan& xrd::diffraction_plan::operator=(xrd::diffraction_plan&&) noexcept = default;
+
+void xrd::diffraction_plan::execute(const rdata_t& angles, rdata_t& intensities) const {
+  intensities.resize(angles.size());
+
+#pragma omp parallel for default(none) shared(angles, intensities)
+  for(sint_t ii = 0; ii < angles.size(); ++ii)
+    intensities(ii) = execute_at(math::deg2rad(angles(ii)));
+}
+
+real_t xrd::diffraction_plan::execute_at(real_t theta) const {
+  const single_plane_diffraction_pattern::workspace& w = *mp_Workspace;
+
+  if(m_Pattern.m_Kernel == kernel_type::e_Reference)
+    return m_Pattern.calculate_intensity_reference(w, theta);
+
+  /* per-thread, so that one plan can be executed concurrently */
+  thread_local stl::vector<real_t> tl_Scattering;
+  tl_Scattering.resize(std::max<std::size_t>(tl_Scattering.size(), m_Pattern.m_Crystal.basis().count()));
+
+  const real_t prefactor = m_Pattern.calculate_scattering(w, theta, tl_Scattering.data());
+  return m_Pattern.calculate_intensity_vectorised(w, std::sin(theta), prefactor, tl_Scattering.data(), 1);
+}
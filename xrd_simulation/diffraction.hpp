@@ -1,18 +1,54 @@
 #ifndef XRD_DIFFRACTION_HPP
 #define XRD_DIFFRACTION_HPP
 
+#include <memory>
+
+#include <math/random.hpp>
+#include <math/sampling.hpp>
+#include <math/summation.hpp>
 #include <types.hpp>
 
 #include "basis.hpp"
 #include "crystal.hpp"
+#include "interference.hpp"
 #include "lattice.hpp"
 
 namespace xrd {
+  /// Mosaic loop implementation used by generate().
+  ///  - e_Reference:  one scattering vector at a time through scherrer_factor() and crystal::structure_factor()
+  ///  - e_Vectorised: structure-of-arrays mosaic set, evaluated in SIMD-friendly blocks of samples
+  enum class kernel_type { e_Reference, e_Vectorised };
+
+  /// Floating point type of the vectorised mosaic loop, chosen at run time.
+  ///  - e_Native: real_t throughout
+  ///  - e_Single: projections, interference tables and the term of each mosaic sample in float (twice the SIMD width);
+  ///              the terms are summed in real_t. Relative error of the pattern is around 1e-4.
+  enum class kernel_precision { e_Native, e_Single };
+
+  /// Options of the adaptive angle grid used by generate_adaptive().
+  struct adaptive_grid {
+    /// every stride-th angle of the requested grid is always evaluated
+    sint_t stride = 32;
+    /// every angle within this many Scherrer widths of a predicted Bragg peak is evaluated
+    real_t peak_widths = 4;
+    /// intervals are bisected until linear interpolation is within tolerance times the maximum intensity
+    real_t tolerance = 1e-4;
+  };
+
+  class diffraction_plan;
+
   class single_plane_diffraction_pattern {
+    friend class diffraction_plan;
+    friend class multi_plane_diffraction_pattern;
+
    public:
-    single_plane_diffraction_pattern(xrd::crystal c, ivector_t<3> c_size, real_t m_spread, uint_t m_samples, rvec3_t plane, real_t temp, real_t wavelength, real_t rec_slit)
+    single_plane_diffraction_pattern(xrd::crystal c, ivector_t<3> c_size, real_t m_spread, uint_t m_samples, rvec3_t plane, real_t temp, real_t wavelength, real_t rec_slit,
+                                     kernel_type kernel = kernel_type::e_Vectorised, math::sampling::method sampling = math::sampling::method::e_Random,
+                                     std::uint64_t seed = math::rand::default_seed(), kernel_precision precision = kernel_precision::e_Native,
+                                     math::summation::method summation = math::summation::method::e_Naive)
         : m_Crystal{std::move(c)}, m_ReciprocalLattice{m_Crystal.lattice().reciprocal()}, m_CrystalliteSize{std::move(c_size)}, m_MosaicSpread{m_spread},
-          m_MosaicSamples{m_samples}, m_Plane{std::move(plane)}, m_Temperature{temp}, m_XrayWavelength{wavelength}, m_ReceivingSollerSlitAngle{rec_slit} {}
+          m_MosaicSamples{m_samples}, m_Plane{std::move(plane)}, m_Temperature{temp}, m_XrayWavelength{wavelength}, m_ReceivingSollerSlitAngle{rec_slit},
+          m_Kernel{kernel}, m_MosaicSampling{sampling}, m_Seed{seed}, m_Precision{precision}, m_Summation{summation} {}
 
     [[nodiscard]] inline rdata_t generate(const rdata_t& angles) const {
       rdata_t intensities(angles.size());
@@ -20,13 +56,50 @@ namespace xrd {
       return intensities;
     }
     void generate(const rdata_t& angles, rdata_t& intensities) const;
+    /// Same as generate(), but only evaluates the kernel near the Bragg peaks predicted from the reciprocal lattice and
+    /// where the pattern is not yet resolved by linear interpolation; the other angles are interpolated. The angles must
+    /// be increasing. Returns the number of kernel evaluations.
+    uint_t generate_adaptive(const rdata_t& angles, rdata_t& intensities, const adaptive_grid& grid = {}) const;
+    /// Same as generate(), but with a given mosaic set in the local frame of the plane (see local_mosaic_set()), rotated
+    /// onto the plane normal of this lattice. Patterns of different lattices evaluated with the same local set differ
+    /// only through the lattice, not through the sampling (common random numbers).
+    [[nodiscard]] inline rdata_t generate_with_mosaic(const rdata_t& angles, const rmatrix_t<3, n_dynamic>& local_mosaics) const {
+      rdata_t intensities(angles.size());
+      generate_with_mosaic(angles, local_mosaics, intensities);
+      return intensities;
+    }
+    void generate_with_mosaic(const rdata_t& angles, const rmatrix_t<3, n_dynamic>& local_mosaics, rdata_t& intensities) const;
+    /// The mosaic set is a pure function of the seed, so repeated calls (on any number of threads) give the same vectors.
     [[nodiscard]] rmatrix_t<3, n_dynamic> generate_random_scattering_vectors() const;
 
+    /// Unit mosaic tilt directions in the local frame of a plane (the plane normal is the z axis). They do not depend on
+    /// the lattice, only on the sampling method, the number of samples, the mosaic spread and the seed.
+    [[nodiscard]] static rmatrix_t<3, n_dynamic> local_mosaic_set(math::sampling::method sampling, uint_t count, real_t spread, std::uint64_t seed);
+    /// Rotates a local mosaic set onto the plane normal and scales it to scattering vectors (at theta = 90 degrees).
+    [[nodiscard]] rmatrix_t<3, n_dynamic> orient_mosaic_set(const rmatrix_t<3, n_dynamic>& local_mosaics) const;
+
+    /// Builds a plan for each call; use plan() when evaluating the same mosaic set repeatedly.
     [[nodiscard]] real_t calculate_intensity_with_mosaic(rmatrix_t<3, n_dynamic> mosaic_planes, real_t angle) const;
 
+    /// Plan over the mosaic set generated from the seed.
+    [[nodiscard]] diffraction_plan plan() const;
+
    private:
     struct workspace;
-    [[nodiscard]] real_t calculate_intensity_internal(const workspace& w, real_t theta) const;
+    struct angle_factors;
+
+    void calculate_intensities(const workspace& w, const rdata_t& thetas, rdata_t& intensities) const;
+    [[nodiscard]] angle_factors calculate_angle_factors(const workspace& w, const rdata_t& thetas) const;
+    [[nodiscard]] stl::vector<bool> predict_peak_regions(const rdata_t& thetas, real_t peak_widths) const;
+    uint_t calculate_intensities_adaptive(const workspace& w, const angle_factors* af, const rdata_t& thetas, const adaptive_grid& grid,
+                                          rdata_t& intensities) const;
+
+    [[nodiscard]] real_t calculate_intensity_reference(const workspace& w, real_t theta) const;
+    [[nodiscard]] real_t calculate_intensity_vectorised(const workspace& w, const angle_factors& af, sint_t index) const;
+    [[nodiscard]] real_t calculate_intensity_vectorised(const workspace& w, real_t sin_theta, real_t prefactor, const real_t* scattering,
+                                                        sint_t scattering_stride) const;
+    /// Writes the scattering amplitude of each basis atom at angle theta and returns the prefactor (see angle_factors).
+    real_t calculate_scattering(const workspace& w, real_t theta, real_t* scattering) const;
 
 
     xrd::crystal m_Crystal;
@@ -42,6 +115,202 @@ namespace xrd {
     real_t m_ReceivingSollerSlitAngle;
 
     real_t m_AbsorptionUT = 0.0025;
+
+    kernel_type m_Kernel;
+    math::sampling::method m_MosaicSampling;
+    std::uint64_t m_Seed;
+    kernel_precision m_Precision;
+    math::summation::method m_Summation;
+  };
+
+  /// Single plane pattern prepared for repeated evaluation with a fixed mosaic set. Everything that does not depend on the
+  /// angle (mosaic projections, Debye-Waller constants, interference tables) is computed once on construction, so
+  /// execute() and execute_at() only run the kernel and do not allocate (apart from growing a per-thread scratch buffer
+  /// the first time a thread uses a plan).
+  class diffraction_plan {
+   public:
+    explicit diffraction_plan(single_plane_diffraction_pattern pattern);
+    diffraction_plan(single_plane_diffraction_pattern pattern, rmatrix_t<3, n_dynamic> mosaic_planes);
+    diffraction_plan(diffraction_plan&&) noexcept;
+    ~diffraction_plan();
+
+    diffraction_plan& operator=(diffraction_plan&&) noexcept;
+
+    /// Angles in degrees, as in single_plane_diffraction_pattern::generate(). Does not allocate if intensities already
+    /// has the size of angles.
+    void execute(const rdata_t& angles, rdata_t& intensities) const;
+    /// Angle theta in radians.
+    [[nodiscard]] real_t execute_at(real_t theta) const;
+
+    [[nodiscard]] inline const single_plane_diffraction_pattern& pattern() const noexcept {
+      return m_Pattern;
+    }
+
+   private:
+    single_plane_diffraction_pattern m_Pattern;
+    std::unique_ptr<const single_plane_diffraction_pattern::workspace> mp_Workspace;
+  };
+
+  /// Sum of the single plane patterns of several planes of the same crystal, evaluated in a single sweep over the angles.
+  /// Everything that does not depend on the plane (thermal factors, form factors, Lorentz-polarisation and absorption
+  /// factors, interference tables) is only computed once.
+  class multi_plane_diffraction_pattern {
+   public:
+    struct reflection {
+      rvec3_t plane;
+      real_t multiplicity = 1;
+    };
+
+    multi_plane_diffraction_pattern(xrd::crystal c, ivector_t<3> c_size, real_t m_spread, uint_t m_samples, std::span<const reflection> reflections, real_t temp,
+                                    real_t wavelength, real_t rec_slit, kernel_type kernel = kernel_type::e_Vectorised,
+                                    math::sampling::method sampling = math::sampling::method::e_Random, std::uint64_t seed = math::rand::default_seed(),
+                                    kernel_precision precision = kernel_precision::e_Native,
+                                    math::summation::method summation = math::summation::method::e_Naive);
+
+    [[nodiscard]] inline rdata_t generate(const rdata_t& angles) const {
+      rdata_t intensities(angles.size());
+      generate(angles, intensities);
+      return intensities;
+    }
+    void generate(const rdata_t& angles, rdata_t& intensities) const;
+    /// Also returns the (unweighted) pattern of each plane as the columns of plane_intensities.
+    void generate(const rdata_t& angles, rdata_t& intensities, rmdata_t& plane_intensities) const;
+    /// Adaptive version of generate() (see single_plane_diffraction_pattern::generate_adaptive()); each plane is refined
+    /// around its own peaks. Returns the total number of kernel evaluations.
+    uint_t generate_adaptive(const rdata_t& angles, rdata_t& intensities, rmdata_t& plane_intensities, const adaptive_grid& grid = {}) const;
+
+    [[nodiscard]] inline const single_plane_diffraction_pattern& plane_pattern(sint_t index) const noexcept {
+      return m_Patterns[index];
+    }
+    [[nodiscard]] inline sint_t plane_count() const noexcept {
+      return m_Patterns.size();
+    }
+
+   private:
+    [[nodiscard]] stl::vector<single_plane_diffraction_pattern::workspace> build_workspaces() const;
+    /// intensities = sum over planes of multiplicity times plane intensity
+    void sum_planes(const rmdata_t& plane_intensities, rdata_t& intensities) const;
+
+    stl::vector<single_plane_diffraction_pattern> m_Patterns;
+    stl::vector<real_t> m_Multiplicities;
+  };
+
+  /// Peak shape of profile_diffraction_pattern.
+  struct peak_profile {
+    /// Lorentzian fraction of the pseudo-Voigt (0: Gaussian, 1: Lorentzian)
+    real_t eta = 0.5;
+    /// peaks are only rendered within this many FWHM of their centre; the area of the Lorentzian tails beyond is added
+    /// back to the rendered part, so the integrated intensity does not depend on the window
+    real_t window = 5;
+    /// Scherrer constant K of FWHM(2 theta) = K lambda / (L cos(theta)); 0.886 matches the main lobe of the interference
+    /// function of the Monte Carlo engines
+    real_t scherrer_constant = 0.886;
+  };
+
+  /// Standard powder model: each order n of each plane is a single peak at its Bragg angle, with integrated intensity
+  /// multiplicity |F|^2 LP DW A and a pseudo-Voigt shape whose width is given by the Scherrer equation for the crystallite
+  /// thickness along the plane normal. Runs in O(peaks x window) instead of O(angles x mosaic samples), at the price of
+  /// ignoring the mosaic spread and the side lobes of the interference function, so it is meant for fitting, with the
+  /// Monte Carlo engines for the final pattern. |F|^2 is normalised as in the Monte Carlo engines (by the sum of the
+  /// squared scattering amplitudes) and each profile has unit area over theta in degrees. The Monte Carlo engines apply
+  /// LP at a fixed peak height, so their peak areas carry an extra width factor (about 1 / (L cos(theta))) and the two
+  /// only agree up to a global factor and that trend.
+  class profile_diffraction_pattern {
+   public:
+    struct peak {
+      /// Bragg angle and full width at half maximum, in degrees of theta
+      real_t theta;
+      real_t fwhm;
+      /// integrated intensity of one plane (without the multiplicity)
+      real_t intensity;
+      /// index into the reflections and diffraction order
+      sint_t reflection;
+      sint_t order;
+    };
+
+    profile_diffraction_pattern(xrd::crystal c, ivector_t<3> c_size, std::span<const multi_plane_diffraction_pattern::reflection> reflections, real_t temp,
+                                real_t wavelength, peak_profile profile = {});
+
+    [[nodiscard]] inline rdata_t generate(const rdata_t& angles) const {
+      rdata_t intensities(angles.size());
+      generate(angles, intensities);
+      return intensities;
+    }
+    /// The angles (in degrees) must be increasing.
+    void generate(const rdata_t& angles, rdata_t& intensities) const;
+    /// Also returns the (unweighted) pattern of each plane as the columns of plane_intensities, as
+    /// multi_plane_diffraction_pattern::generate().
+    void generate(const rdata_t& angles, rdata_t& intensities, rmdata_t& plane_intensities) const;
+
+    /// Peaks with their Bragg angle in [theta_min, theta_max] (in degrees), sorted by reflection and order. Orders that are
+    /// systematically absent in the space group of the crystal are left out.
+    [[nodiscard]] stl::vector<peak> peaks(real_t theta_min, real_t theta_max) const;
+
+    [[nodiscard]] inline sint_t plane_count() const noexcept {
+      return m_Reflections.size();
+    }
+
+   private:
+    /// Adds the profile of p (times scale) to the pattern on the increasing grid angles.
+    void render(const peak& p, real_t scale, const rdata_t& angles, real_t* intensities) const;
+
+    xrd::crystal m_Crystal;
+    xrd::lattice m_ReciprocalLattice;
+    ivector_t<3> m_CrystalliteSize;
+    stl::vector<multi_plane_diffraction_pattern::reflection> m_Reflections;
+
+    real_t m_Temperature;
+    real_t m_XrayWavelength;
+    peak_profile m_Profile;
+
+    real_t m_AbsorptionUT = 0.0025;
+  };
+
+  /// Peak positions of a single plane pattern without evaluating it, for fits that only need to know where the peaks are.
+  /// Every order n of the primitive plane direction (the single plane patterns contain all of them) is placed at its
+  /// Bragg angle, with the integrated intensity of profile_diffraction_pattern. The maxima of the Monte Carlo patterns are
+  /// slightly off the Bragg angles, since the angular factors vary across a peak and the mosaic tilts are weighted by the
+  /// receiving slit; calibrate() measures this shift per order on one Monte Carlo pattern and predict() adds it. The shift
+  /// only changes slowly with the lattice, so one calibration near the expected solution serves a whole fit.
+  class bragg_peak_predictor {
+   public:
+    struct peak {
+      /// in degrees of theta, not bound to any angle grid
+      real_t theta;
+      /// integrated intensity of the order (see profile_diffraction_pattern::peak)
+      real_t intensity;
+      sint_t order;
+    };
+
+    bragg_peak_predictor(ivector_t<3> c_size, rvec3_t plane, real_t temp, real_t wavelength);
+
+    /// Peaks of crystal c with their predicted angle in [theta_min, theta_max] (in degrees), sorted by angle. Orders that
+    /// are systematically absent or whose |F|^2 vanishes for the basis are left out, as they give no maximum.
+    [[nodiscard]] stl::vector<peak> predict(const crystal& c, real_t theta_min, real_t theta_max) const;
+
+    /// Sets the shift of each order to the distance from its Bragg angle in crystal c to the maximum of intensities (the
+    /// pattern of the plane in c on the increasing grid angles, in degrees), refined between the grid points. Orders
+    /// without a resolved maximum within one Scherrer width of their Bragg angle are not shifted.
+    void calibrate(const crystal& c, const rdata_t& angles, const rdata_t& intensities);
+
+    [[nodiscard]] inline const rvec3_t& plane() const noexcept {
+      return m_Plane;
+    }
+
+   private:
+    /// Uncorrected peaks of crystal c with their Bragg angle in [theta_min, theta_max] (in degrees).
+    [[nodiscard]] stl::vector<profile_diffraction_pattern::peak> bragg_peaks(const crystal& c, real_t theta_min, real_t theta_max) const;
+
+    ivector_t<3> m_CrystalliteSize;
+    rvec3_t m_Plane;
+    /// primitive direction of m_Plane
+    rvec3_t m_Direction;
+
+    real_t m_Temperature;
+    real_t m_XrayWavelength;
+
+    /// shift of order n (in degrees) at index n - 1
+    stl::vector<real_t> m_Shifts;
   };
 
   inline real_t scherrer_factor(const lattice& latt, const ivector_t<3>& sizes, const rvec3_t& wavevector) {
@@ -61,6 +330,11 @@ namespace xrd {
     return fn_fac(0) * fn_fac(1) * fn_fac(2);
   }
 
+  inline real_t scherrer_factor(const lattice& latt, const std::array<interference_function, 3>& xi, const rvec3_t& wavevector) noexcept {
+    const rvec3_t x = latt.basis_matrix().transpose() * wavevector / 2;
+    return xi[0](x(0)) * xi[1](x(1)) * xi[2](x(2));
+  }
+
   inline real_t lorentz_factor(real_t angle) noexcept {
     real_t sin = std::sin(angle);
     return 1 / (4 * sin * sin * std::cos(angle));
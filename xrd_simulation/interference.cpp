@@ -0,0 +1,54 @@
+#include "interference.hpp"
+
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+xrd::interference_function::interference_function(sint_t n, sint_t samples_per_fringe)
+    : m_N{n}, m_Step{C_PI / (n * samples_per_fringe)}, m_InvStep{1 / m_Step}, m_LastInterval{0} {
+  if(n <= 0)
+    throw std::invalid_argument(fmt::format("invalid crystallite size ({}): must be positive", n));
+  if(samples_per_fringe <= 0)
+    throw std::invalid_argument(fmt::format("invalid samples per fringe ({}): must be positive", samples_per_fringe));
+
+  /* nodes cover [0, pi/2] plus one spare node so that the last interval always has a right neighbour */
+  const sint_t count = (n * samples_per_fringe + 1) / 2 + 2;
+  m_LastInterval = count - 2;
+  m_Table.resize(count);
+
+  for(sint_t ii = 0; ii < count; ++ii) {
+    const real_t x = ii * m_Step;
+    const real_t sin_x = std::sin(x), cos_x = std::cos(x);
+    const real_t sin_nx = std::sin(n * x), cos_nx = std::cos(n * x);
+
+    real_t g, dg;
+    if(sin_x < 1e-4) {
+      /* g(x) = sin(N x) / (N sin(x)) ~ 1 - (N^2 - 1) x^2 / 6 around the principal maximum */
+      const real_t c = (real_t(n) * n - 1) / 6;
+      g = 1 - c * x * x;
+      dg = -2 * c * x;
+    } else {
+      g = sin_nx / (n * sin_x);
+      dg = (n * cos_nx * sin_x - sin_nx * cos_x) / (n * sin_x * sin_x);
+    }
+
+    m_Table[ii] = {g * g, 2 * g * dg * m_Step};
+  }
+
+  m_TableSingle.resize(count);
+  for(sint_t ii = 0; ii < count; ++ii)
+    m_TableSingle[ii] = {static_cast<float>(m_Table[ii].f), static_cast<float>(m_Table[ii].df)};
+}
+
+void xrd::interference_function::operator()(std::span<const real_t> x, std::span<real_t> out) const noexcept {
+  const sint_t count = std::min(x.size(), out.size());
+
+#pragma omp simd
+  for(sint_t ii = 0; ii < count; ++ii)
+    out[ii] = (*this)(x[ii]);
+}
+
+real_t xrd::interference_function::error_bound() const noexcept {
+  const real_t h_d = m_Step * (2 * m_N - 2);
+  return (h_d * h_d) * (h_d * h_d) / 384 + 8 * std::numeric_limits<real_t>::epsilon();
+}
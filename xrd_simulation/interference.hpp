@@ -0,0 +1,80 @@
+#ifndef XRD_INTERFERENCE_HPP
+#define XRD_INTERFERENCE_HPP
+
+#include <span>
+
+#include <constants.hpp>
+#include <types.hpp>
+
+namespace xrd {
+  /// Normalised interference function (sin(N x) / (N sin(x)))^2 of a row of N unit cells.
+  ///
+  /// The function is even and pi-periodic, so arguments are reduced to [0, pi/2] and interpolated with cubic Hermite
+  /// polynomials from a table of values and derivatives with a fixed number of nodes per fringe (pi / N). The sin(x) -> 0
+  /// limit is handled when the table is built, so evaluation is branch-free.
+  ///
+  /// Since the function is a trigonometric polynomial of degree 2(N - 1) whose coefficients have unit absolute sum, the
+  /// interpolation error is bounded by h^4 (2N - 2)^4 / 384, where h is the node spacing (see error_bound()).
+  class interference_function {
+    template <typename T>
+    struct basic_node {
+      T f;
+      T df;    // derivative pre-multiplied by the node spacing
+    };
+    using node = basic_node<real_t>;
+
+   public:
+    explicit interference_function(sint_t n, sint_t samples_per_fringe = 128);
+
+    [[nodiscard]] static real_t exact(sint_t n, real_t x) noexcept {
+      const real_t xr = reduce(x);
+      const real_t sin_x = std::sin(xr);
+      const real_t f = (sin_x == 0) ? 1 : (std::sin(n * xr) / (n * sin_x));
+      return f * f;
+    }
+
+    [[nodiscard]] inline real_t operator()(real_t x) const noexcept {
+      const real_t t = std::abs(reduce(x)) * m_InvStep;
+      const sint_t ii = std::min(static_cast<sint_t>(t), m_LastInterval);
+      const real_t u = t - ii;
+      const real_t v = 1 - u;
+
+      const node& n0 = m_Table[ii];
+      const node& n1 = m_Table[ii + 1];
+      return v * v * ((1 + 2 * u) * n0.f + u * n0.df) + u * u * ((3 - 2 * u) * n1.f - v * n1.df);
+    }
+    void operator()(std::span<const real_t> x, std::span<real_t> out) const noexcept;
+
+    /// Single precision evaluation from a single precision copy of the table, for the float mosaic kernel.
+    [[nodiscard]] inline float single(float x) const noexcept {
+      const float t = std::abs(x - float(C_PI) * std::nearbyint(x * float(1 / C_PI))) * float(m_InvStep);
+      const sint_t ii = std::min(static_cast<sint_t>(t), m_LastInterval);
+      const float u = t - ii;
+      const float v = 1 - u;
+
+      const basic_node<float>& n0 = m_TableSingle[ii];
+      const basic_node<float>& n1 = m_TableSingle[ii + 1];
+      return v * v * ((1 + 2 * u) * n0.f + u * n0.df) + u * u * ((3 - 2 * u) * n1.f - v * n1.df);
+    }
+
+    [[nodiscard]] inline sint_t n() const noexcept {
+      return m_N;
+    }
+    [[nodiscard]] real_t error_bound() const noexcept;
+
+   private:
+    /// Reduces x to [-pi/2, pi/2].
+    [[nodiscard]] inline static real_t reduce(real_t x) noexcept {
+      return x - C_PI * std::nearbyint(x * (1 / C_PI));
+    }
+
+    sint_t m_N;
+    real_t m_Step;
+    real_t m_InvStep;
+    sint_t m_LastInterval;
+    stl::vector<node> m_Table;
+    stl::vector<basic_node<float>> m_TableSingle;
+  };
+}    // namespace xrd
+
+#endif    //XRD_INTERFERENCE_HPP
@@ -4,8 +4,21 @@
 
 #include <nlohmann/json.hpp>
 
+#include <math.hpp>
 #include <types_json.hpp>
 
+xrd::lattice xrd::lattice::from_parameters(real_t a, real_t b, real_t c, real_t alpha, real_t beta, real_t gamma) {
+  const real_t cos_a = std::cos(math::deg2rad(alpha)), cos_b = std::cos(math::deg2rad(beta));
+  const real_t cos_g = std::cos(math::deg2rad(gamma)), sin_g = std::sin(math::deg2rad(gamma));
+
+  const real_t cy = (cos_a - cos_b * cos_g) / sin_g;
+  const real_t cz2 = 1 - cos_b * cos_b - cy * cy;
+  if(a <= 0 || b <= 0 || c <= 0 || sin_g <= 0 || cz2 <= 0)
+    throw std::invalid_argument(fmt::format("invalid cell parameters: a={} b={} c={} alpha={} beta={} gamma={}", a, b, c, alpha, beta, gamma));
+
+  return {rvec3_t{a, 0, 0}, rvec3_t{b * cos_g, b * sin_g, 0}, rvec3_t{c * cos_b, c * cy, c * std::sqrt(cz2)}};
+}
+
 xrd::lattice nlohmann::adl_serializer<xrd::lattice>::from_json(const nlohmann::json& j) {
   if(j.contains("type")) {
     auto type = j.at("type").get<std::string>();
@@ -15,6 +28,9 @@ xrd::lattice nlohmann::adl_serializer<xrd::lattice>::from_json(const nlohmann::j
       return xrd::lattice::fcc(j.at("a").get<real_t>());
     else if(type == "fcc_tetragonal")
       return xrd::lattice::fcc_tetragonal(j.at("a").get<real_t>(), j.at("c").get<real_t>());
+    else if(type == "parameters")
+      return xrd::lattice::from_parameters(j.at("a").get<real_t>(), j.at("b").get<real_t>(), j.at("c").get<real_t>(), j.at("alpha").get<real_t>(),
+                                           j.at("beta").get<real_t>(), j.at("gamma").get<real_t>());
     else
       throw std::runtime_error(fmt::format("unrecognized lattice type: {}", type));
   } else {
@@ -23,6 +23,10 @@ namespace xrd {
       return {a * rvec3_t{1, 1, 0}.normalized(), a * rvec3_t{1, -1, 0}.normalized(), c * rvec3_t{0, 0, 1}};
     }
 
+    /// Cell with edge lengths a, b, c and angles alpha (between b and c), beta, gamma in degrees; a is along x and b in the
+    /// xy plane.
+    static lattice from_parameters(real_t a, real_t b, real_t c, real_t alpha, real_t beta, real_t gamma);
+
     lattice(const rvec3_t& a, const rvec3_t& b, const rvec3_t& c) noexcept : m_Lattice{} {
       m_Lattice.col(0) = a;
       m_Lattice.col(1) = b;
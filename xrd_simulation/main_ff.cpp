@@ -6,9 +6,8 @@
 
 int main(int argc, char** argv) {
   auto fn_gen_ff = [](uint_t Z, const rdata_t& x) {
-    rdata_t ff{x.size()};
-    for(size_t ii = 0; ii < ff.size(); ++ii)
-      ff(ii) = xrd::tables::f0(Z, x(ii));
+    rdata_t ff(x.size());
+    xrd::tables::f0(Z, std::span<const real_t>(x.data(), x.size()), std::span<real_t>(ff.data(), ff.size()));
     return ff;
   };
 
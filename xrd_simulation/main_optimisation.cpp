@@ -1,11 +1,16 @@
+#include <algorithm>
+#include <array>
 #include <numeric>
+#include <optional>
 
 #include <fmt/format.h>
 
 #include <data/dataset_2d.hpp>
 #include <io.hpp>
 #include <math.hpp>
+#include <math/random.hpp>
 #include <optimisation/simulated_annealing.hpp>
+#include <simd.hpp>
 #include <timer.hpp>
 
 #include "basis.hpp"
@@ -38,9 +43,36 @@ namespace {
    public:
     using solution_type = std::array<real_t, 2>;
 
+    /// How energy() finds the simulated peaks.
+    ///  - e_MonteCarlo: maxima of the Monte Carlo pattern of each plane on the angle grid
+    ///  - e_Analytic:   Bragg angles of the candidate lattice plus the shift of the Monte Carlo maxima, measured once on
+    ///                  the nominal lattice (see xrd::bragg_peak_predictor); not bound to the angle grid. Planes
+    ///                  other than the calibrated ones fall back to e_MonteCarlo
+    enum class energy_mode { e_MonteCarlo, e_Analytic };
+
+    /// With common_random_numbers, the mosaic set of each plane is sampled once (in the local frame of the plane) and
+    /// only rotated onto the plane normal of each candidate lattice, so neighbouring solutions see the same sampling
+    /// noise. Otherwise every energy() call draws a new mosaic set from the calling thread's generator, which
+    /// opt::simulated_annealer::run_parallel() seeds per chain. seed fixes the common mosaic sets and the calibration of
+    /// e_Analytic, so that together with the seed of the annealer it reproduces the whole run.
+    xrd_annealing_simulation(ivector_t<3> size, real_t mspread, real_t temp, real_t lambda, real_t rec_slit, rdata_t angles, bool common_random_numbers = true,
+                             energy_mode mode = energy_mode::e_MonteCarlo, std::uint64_t seed = math::rand::default_seed())
+        : m_Size{std::move(size)}, m_MosaicSpread{mspread}, m_Temperature{temp}, m_Wavelength{lambda}, m_ReceivingSlitAngle{rec_slit},
+          m_Angles{std::move(angles)}, m_Planes{rvec3_t{0, 0, 1}, rvec3_t{1, 1, 0}, rvec3_t{1, 1, 1}, rvec3_t{2, 0, 0}}, m_Mode{mode} {
+      if(common_random_numbers)
+        for(const rvec3_t& plane : m_Planes)
+          m_LocalMosaics.push_back({plane, xrd::single_plane_diffraction_pattern::local_mosaic_set(math::sampling::method::e_Random, k_MosaicSamples,
+                                                                                                   m_MosaicSpread, math::rand::derive_key(seed, plane_index(plane)))});
+
+      if(m_Mode == energy_mode::e_Analytic) {
+        /* the only Monte Carlo patterns of the run; keyed on streams after those of the common mosaic sets */
+        const xrd::crystal nominal = make_crystal({k_NominalA, k_NominalC});
+        for(const rvec3_t& plane : m_Planes) {
+          xrd::bragg_peak_predictor& predictor = m_Predictors.emplace_back(m_Size, plane, m_Temperature, m_Wavelength);
+          predictor.calibrate(nominal, m_Angles, simulate_plane(nominal, plane, math::rand::derive_key(seed, m_Planes.size() + plane_index(plane))));
+        }
+      }
 
-    xrd_annealing_simulation(ivector_t<3> size, real_t mspread, real_t temp, real_t lambda, rdata_t angles)
-        : m_Size{std::move(size)}, m_MosaicSpread{mspread}, m_Temperature{temp}, m_Wavelength{lambda}, m_Angles{std::move(angles)} {
       ds::dataset_2d pattern(io::load_csv("fept/AJA_1249_MgO-FePt-Pt_190s_XRD_Phil_Theta_2-Theta_signal.txt"));
 
       m_Peak_001 = pattern.get(22.5, 27.5).find_peaks()[0].x;
@@ -55,12 +87,12 @@ namespace {
     [[nodiscard]] inline solution_type initial_solution() const noexcept {
       //            real_t r0 = (2 * math::rand::unit() - 1) * 0.25, r1 = (2 * math::rand::unit() - 1) * 0.25;
       real_t r0 = (2 * math::rand::unit() - 1) * 0.01, r1 = (2 * math::rand::unit() - 1) * 0.01;
-      return {{(1 + r0) * 3.85, (1 + r1) * 3.71}};
+      return {{(1 + r0) * k_NominalA, (1 + r1) * k_NominalC}};
       //      return {{(1 + r0) * 2.728, (1 + r1) * 3.779}};
     }
 
     [[nodiscard]] real_t energy(const solution_type& s) const noexcept {
-      const xrd::crystal strained_crystal{xrd::lattice::fcc_tetragonal(s[0], s[1]), xrd::basis{{26, 55.84, {0, 0, 0}}, {78, 195.08, {0.5, 0.5, 0.5}}}, 230};
+      const xrd::crystal strained_crystal = make_crystal(s);
 
       auto peaks_001 = find_peak_positions_for_plane(strained_crystal, {0, 0, 1});
       if(peaks_001.size() < 2)
@@ -77,10 +109,22 @@ namespace {
     }
 
    private:
+    [[nodiscard]] static xrd::crystal make_crystal(const solution_type& s) {
+      return {xrd::lattice::fcc_tetragonal(s[0], s[1]), xrd::basis{{26, 55.84, {0, 0, 0}}, {78, 195.08, {0.5, 0.5, 0.5}}}, 230};
+    }
+
     [[nodiscard]] stl::vector<real_t> find_peak_positions_for_plane(const xrd::crystal& c, const rvec3_t& plane) const {
-      const xrd::single_plane_diffraction_pattern experiment(c, m_Size, m_MosaicSpread, 1000, plane, m_Temperature, m_Wavelength);
+      /* planes without a calibrated predictor fall back to the Monte Carlo maxima */
+      const auto it = std::find_if(m_Predictors.begin(), m_Predictors.end(), [&plane](const xrd::bragg_peak_predictor& p) { return p.plane() == plane; });
+      if(it != m_Predictors.end()) {
+        const auto predicted = it->predict(c, m_Angles(0), m_Angles(m_Angles.size() - 1));
+
+        stl::vector<real_t> peaks(predicted.size());
+        std::transform(predicted.begin(), predicted.end(), peaks.begin(), [](const xrd::bragg_peak_predictor::peak& p) { return p.theta; });
+        return peaks;
+      }
 
-      const auto intensities = experiment.generate(m_Angles);
+      const auto intensities = simulate_plane(c, plane);
       auto peak_indices = math::find_peak_indices(intensities);
       std::sort(peak_indices.begin(), peak_indices.end());
 
@@ -90,6 +134,26 @@ namespace {
       return peaks;
     }
 
+    /// Pattern of one plane, on its common mosaic set if there is one and otherwise on a new mosaic set drawn with key.
+    /// Without a key, it is drawn from the calling thread's generator, so that it follows the random stream of the
+    /// annealing chain rather than the order in which concurrent chains reach this point. The common mosaic sets leave
+    /// that stream alone.
+    [[nodiscard]] rdata_t simulate_plane(const xrd::crystal& c, const rvec3_t& plane, std::optional<std::uint64_t> key = std::nullopt) const {
+      const auto it = std::find_if(m_LocalMosaics.begin(), m_LocalMosaics.end(), [&plane](const plane_mosaic& m) { return m.plane == plane; });
+      if(it == m_LocalMosaics.end() && !key)
+        key = math::rand::derive_key(math::rand::tl_Generator(), plane_index(plane));
+
+      const xrd::single_plane_diffraction_pattern experiment(c, m_Size, m_MosaicSpread, k_MosaicSamples, plane, m_Temperature, m_Wavelength,
+                                                             m_ReceivingSlitAngle, xrd::kernel_type::e_Vectorised, math::sampling::method::e_Random,
+                                                             key.value_or(0));
+      return (it != m_LocalMosaics.end()) ? experiment.generate_with_mosaic(m_Angles, it->local) : experiment.generate(m_Angles);
+    }
+
+    /* position of plane in m_Planes, m_Planes.size() for any other plane */
+    [[nodiscard]] std::uint64_t plane_index(const rvec3_t& plane) const noexcept {
+      return std::find(m_Planes.begin(), m_Planes.end(), plane) - m_Planes.begin();
+    }
+
     [[nodiscard]] real_t secondary_peaks_energy(const xrd::crystal& c) const {
       //      auto peaks_110 = find_peak_positions_for_plane(c, {1, 1, 0});
       //      if(peaks_110.size() < 1)
@@ -126,13 +190,32 @@ namespace {
       return e_110 + e_111 + e_100;
     }
 
+    struct plane_mosaic {
+      rvec3_t plane;
+      rmatrix_t<3, n_dynamic> local;
+    };
+
+    static constexpr uint_t k_MosaicSamples = 1000;
+    /* centre of the initial solutions and lattice of the calibration */
+    static constexpr real_t k_NominalA = 3.85, k_NominalC = 3.71;
+
     ivector_t<3> m_Size;
     real_t m_MosaicSpread;
 
     real_t m_Temperature;
     real_t m_Wavelength;
+    real_t m_ReceivingSlitAngle;
+
+    /* empty unless common random numbers are used */
+    stl::vector<plane_mosaic> m_LocalMosaics;
 
     rdata_t m_Angles;
+    /* planes of the common mosaic sets and the predictors */
+    std::array<rvec3_t, 4> m_Planes;
+
+    energy_mode m_Mode;
+    /* one per plane, calibrated on the nominal lattice; empty in e_MonteCarlo */
+    stl::vector<xrd::bragg_peak_predictor> m_Predictors;
 
     real_t m_Peak_001, m_Peak_110, m_Peak_111, m_Peak_200, m_Peak_002;
   };
@@ -153,14 +236,20 @@ struct fmt::formatter<xrd_annealing_simulation::solution_type> {
 
 int main(int argc, char** argv) {
   fmt::format("{}", xrd_annealing_simulation::solution_type{});
+  fmt::print("SIMD: {0} (detected {1})\n", simd::to_string(simd::selected()), simd::to_string(simd::detect()));
 
   hr_timer timer{"Annealing"};
 
+  /* reproduces the whole run; the simulation and the annealer get independent keys from it */
+  const std::uint64_t seed = math::rand::default_seed();
+  fmt::print("Seed: {}\n", seed);
+
   opt::simulated_annealer<xrd_annealing_simulation, true> annealer;
-  const xrd_annealing_simulation xas({40, 40, 40}, math::deg2rad(0.5), 300, xray::CuKalpha::lambda, math::data::linspace(10, 30, 2000));
+  const xrd_annealing_simulation xas({40, 40, 40}, math::deg2rad(0.5), 300, xray::CuKalpha::lambda, math::deg2rad(5), math::data::linspace(10, 30, 2000), true,
+                                     xrd_annealing_simulation::energy_mode::e_Analytic, math::rand::derive_key(seed, 0));
 
   timer.start();
-  auto s = annealer.run(xas, 10, 100);
+  auto s = annealer.run_parallel(xas, 10, 100, {.seed = math::rand::derive_key(seed, 1)});
   timer.stop();
   timer.report();
 
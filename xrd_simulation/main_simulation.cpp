@@ -1,4 +1,5 @@
 #include <numeric>
+#include <optional>
 
 #include <fmt/format.h>
 
@@ -7,6 +8,8 @@
 #include <data/dataset_2d.hpp>
 #include <io.hpp>
 #include <math.hpp>
+#include <math/summation.hpp>
+#include <simd.hpp>
 #include <timer.hpp>
 #include <types_format.hpp>
 #include <types_json.hpp>
@@ -15,6 +18,7 @@
 #include "crystal.hpp"
 #include "diffraction.hpp"
 #include "lattice.hpp"
+#include "reflections.hpp"
 
 using json = nlohmann::json;
 
@@ -67,6 +71,13 @@ int main(int argc, char** argv) {
   uint_t mosaic_samples;
   rdata_t angles;
   bool with_bg;
+  xrd::kernel_type kernel = xrd::kernel_type::e_Vectorised;
+  xrd::kernel_precision precision = xrd::kernel_precision::e_Native;
+  math::summation::method summation = math::summation::method::e_Naive;
+  math::sampling::method sampling = math::sampling::method::e_Random;
+  std::uint64_t seed;
+  std::optional<xrd::adaptive_grid> grid;
+  std::optional<xrd::peak_profile> profile;
   {
     const auto& c_env = config.at("computational_environment");
 
@@ -79,6 +90,97 @@ int main(int argc, char** argv) {
     global_factor = c_env.contains("global_factor") ? c_env.at("global_factor").get<real_t>() : 1;
 
     with_bg = c_env.contains("with_bg") ? c_env.at("with_bg").get<bool>() : false;
+
+    if(c_env.contains("kernel")) {
+      auto type = c_env.at("kernel").get<std::string>();
+      if(type == "reference")
+        kernel = xrd::kernel_type::e_Reference;
+      else if(type == "vectorised")
+        kernel = xrd::kernel_type::e_Vectorised;
+      else
+        throw std::runtime_error(fmt::format("unrecognized kernel type: {}", type));
+    }
+
+    if(c_env.contains("precision")) {
+      auto type = c_env.at("precision").get<std::string>();
+      if(type == "native")
+        precision = xrd::kernel_precision::e_Native;
+      else if(type == "single")
+        precision = xrd::kernel_precision::e_Single;
+      else
+        throw std::runtime_error(fmt::format("unrecognized kernel precision: {}", type));
+    }
+
+    if(c_env.contains("summation")) {
+      auto type = c_env.at("summation").get<std::string>();
+      if(type == "naive")
+        summation = math::summation::method::e_Naive;
+      else if(type == "pairwise")
+        summation = math::summation::method::e_Pairwise;
+      else if(type == "neumaier")
+        summation = math::summation::method::e_Neumaier;
+      else if(type == "double_double")
+        summation = math::summation::method::e_DoubleDouble;
+      else
+        throw std::runtime_error(fmt::format("unrecognized summation method: {}", type));
+    }
+
+    /* overrides the detected instruction set (and XRD_SIMD) for every dispatched kernel */
+    if(c_env.contains("simd"))
+      simd::force(simd::from_string(c_env.at("simd").get<std::string>()));
+    fmt::print("SIMD: {0} (detected {1})\n", simd::to_string(simd::selected()), simd::to_string(simd::detect()));
+
+    if(c_env.contains("mosaic_sampling")) {
+      auto type = c_env.at("mosaic_sampling").get<std::string>();
+      if(type == "random")
+        sampling = math::sampling::method::e_Random;
+      else if(type == "sobol")
+        sampling = math::sampling::method::e_Sobol;
+      else if(type == "halton")
+        sampling = math::sampling::method::e_Halton;
+      else if(type == "stratified")
+        sampling = math::sampling::method::e_Stratified;
+      else if(type == "antithetic")
+        sampling = math::sampling::method::e_Antithetic;
+      else
+        throw std::runtime_error(fmt::format("unrecognized mosaic sampling method: {}", type));
+    }
+
+    seed = c_env.contains("seed") ? c_env.at("seed").get<std::uint64_t>() : math::rand::default_seed();
+
+    if(c_env.contains("adaptive_grid")) {
+      const auto& g_config = c_env.at("adaptive_grid");
+      if(g_config.is_boolean()) {
+        if(g_config.get<bool>())
+          grid.emplace();
+      } else {
+        grid.emplace();
+        if(g_config.contains("stride"))
+          g_config.at("stride").get_to(grid->stride);
+        if(g_config.contains("peak_widths"))
+          g_config.at("peak_widths").get_to(grid->peak_widths);
+        if(g_config.contains("tolerance"))
+          g_config.at("tolerance").get_to(grid->tolerance);
+      }
+    }
+
+    /* "monte_carlo" sums the mosaic samples at every angle, "profile" renders one pseudo-Voigt per Bragg peak */
+    if(c_env.contains("engine")) {
+      auto type = c_env.at("engine").get<std::string>();
+      if(type == "profile")
+        profile.emplace();
+      else if(type != "monte_carlo")
+        throw std::runtime_error(fmt::format("unrecognized diffraction engine: {}", type));
+    }
+    if(profile && c_env.contains("profile")) {
+      const auto& p_config = c_env.at("profile");
+      if(p_config.contains("eta"))
+        p_config.at("eta").get_to(profile->eta);
+      if(p_config.contains("window"))
+        p_config.at("window").get_to(profile->window);
+      if(p_config.contains("scherrer_constant"))
+        p_config.at("scherrer_constant").get_to(profile->scherrer_constant);
+    }
   }
 
   real_t wavelength, temperature, slit_angle;
@@ -90,34 +192,76 @@ int main(int argc, char** argv) {
     slit_angle = math::deg2rad(p_env.at("receiving_slit_angle").get<real_t>());
   }
 
-  rdata_t xrd_pattern = rdata_t::Zero(angles.size());
+  /* the crystals are summed angle by angle with the same method as the mosaic samples and the planes */
+  stl::vector<math::summation::accumulator<real_t>> pattern_sum(angles.size(), math::summation::accumulator<real_t>{summation});
+  uint_t crystal_index = 0;
   for(const auto& c : config.at("crystals")) {
     xrd::crystal crystal = c;
+    const std::uint64_t crystal_key = math::rand::derive_key(seed, crystal_index++);
 
     std::string name = c.contains("name") ? c.at("name") : "";
 
     ivec3_t crystallite_size = c.at("crystallite_size").get<ivec3_t>();
     real_t mosaic_spread = math::deg2rad(c.at("mosaic_spread").get<real_t>());
 
-    const auto& p = c.at("patterns");
     fmt::print("Crystal: {0}\n", name);
-    for(const auto& p_config : p) {
-      real_t multiplicity = p_config.contains("multiplicity") ? p_config.at("multiplicity").get<real_t>() : 1;
-      if(multiplicity != 0) {
-        rvec3_t plane = p_config.at("plane").get<rvec3_t>();
-
-        xrd::single_plane_diffraction_pattern experiment(crystal, crystallite_size, mosaic_spread, mosaic_samples, plane, temperature, wavelength, slit_angle);
+    if(crystal.space_group())
+      fmt::print("  space group {0}: {1} operations, {2} atoms in the cell\n", crystal.space_group()->symbol(), crystal.space_group()->operations().size(),
+                 crystal.basis().count());
 
-        rdata_t e_pat = experiment.generate(angles);
-        {
-          ds::dataset_2d_view dset = ds::dataset_2d_view(angles, e_pat, ds::no_validation);
-          fmt::print("  {0}: {{{1}}}\n", plane, fmt::join(dset.find_peaks(0.1), ", "));
+    stl::vector<xrd::multi_plane_diffraction_pattern::reflection> reflections;
+    if(c.contains("powder") && c.at("powder").get<bool>()) {
+      /* every reflection with its Bragg angle in the simulated range, one pattern per group of equivalent planes */
+      const auto groups = xrd::powder_reflections(crystal, crystallite_size, wavelength, math::deg2rad(angles(0)), math::deg2rad(angles(angles.size() - 1)));
+      uint_t directions = 0;
+      for(const auto& g : groups) {
+        reflections.push_back({g.plane.cast<real_t>(), real_t(g.multiplicity)});
+        directions += g.multiplicity;
+      }
+      fmt::print("  powder: {0} reflection groups ({1} lattice directions)\n", groups.size(), directions);
+    } else {
+      for(const auto& p_config : c.at("patterns")) {
+        real_t multiplicity = p_config.contains("multiplicity") ? p_config.at("multiplicity").get<real_t>() : 1;
+        const rvec3_t plane = p_config.at("plane").get<rvec3_t>();
+        if(multiplicity == 0)
+          continue;
+        if(xrd::is_extinct(crystal, plane, wavelength, math::deg2rad(angles(0)), math::deg2rad(angles(angles.size() - 1)))) {
+          fmt::print("  {0}: systematically absent, skipped\n", plane);
+          continue;
         }
-        xrd_pattern += multiplicity * e_pat;
+        reflections.push_back({plane, multiplicity});
       }
     }
+    if(reflections.empty())
+      continue;
+
+    rdata_t c_pat;
+    rmdata_t plane_pats;
+    if(profile) {
+      xrd::profile_diffraction_pattern experiment(crystal, crystallite_size, reflections, temperature, wavelength, *profile);
+      experiment.generate(angles, c_pat, plane_pats);
+    } else {
+      xrd::multi_plane_diffraction_pattern experiment(crystal, crystallite_size, mosaic_spread, mosaic_samples, reflections, temperature, wavelength, slit_angle,
+                                                      kernel, sampling, crystal_key, precision, summation);
+      if(grid) {
+        const uint_t evaluations = experiment.generate_adaptive(angles, c_pat, plane_pats, *grid);
+        fmt::print("  adaptive grid: {0} of {1} angles evaluated\n", evaluations, plane_pats.size());
+      } else {
+        experiment.generate(angles, c_pat, plane_pats);
+      }
+    }
+    for(sint_t kk = 0; kk < plane_pats.cols(); ++kk) {
+      ds::dataset_2d_view dset = ds::dataset_2d_view(angles, std::span<const real_t>(plane_pats.col(kk).data(), plane_pats.rows()), ds::no_validation);
+      fmt::print("  {0}: {{{1}}}\n", reflections[kk].plane, fmt::join(dset.find_peaks(0.1), ", "));
+    }
+    for(sint_t ii = 0; ii < c_pat.size(); ++ii)
+      pattern_sum[ii] += c_pat(ii);
   }
 
+  rdata_t xrd_pattern(angles.size());
+  for(sint_t ii = 0; ii < xrd_pattern.size(); ++ii)
+    xrd_pattern(ii) = pattern_sum[ii].value();
+
   std::string output_path = config.at("output_path").get<std::string>();
 
   if(with_bg)
@@ -0,0 +1,186 @@
+#include "reflections.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+
+#include <fmt/format.h>
+
+#include <Eigen/Cholesky>
+
+namespace {
+  /* relative tolerance for equal |G|, metrics and |F|^2 */
+  constexpr real_t k_Tolerance = 1e-6;
+
+  using permutation = rmatrix_t<3, 3>;
+
+  /* the 48 signed permutations of the axes (the holohedry of the cube); the other lattices' point groups are subgroups
+   * of it once their metric is checked */
+  stl::vector<permutation> signed_permutations() {
+    stl::vector<permutation> result;
+    std::array<sint_t, 3> axes{0, 1, 2};
+    do {
+      for(sint_t signs = 0; signs < 8; ++signs) {
+        permutation p = permutation::Zero();
+        for(sint_t ii = 0; ii < 3; ++ii)
+          p(ii, axes[ii]) = (signs & (1 << ii)) ? -1 : 1;
+        result.push_back(p);
+      }
+    } while(std::next_permutation(axes.begin(), axes.end()));
+    return result;
+  }
+
+  ivec3_t primitive(const ivec3_t& h) {
+    const sint_t g = std::gcd(std::gcd(h(0), h(1)), h(2));
+    return h / g;
+  }
+}    // namespace
+
+stl::vector<ivec3_t> xrd::enumerate_reciprocal_vectors(const lattice& reciprocal, real_t g_max) {
+  stl::vector<ivec3_t> result;
+  if(g_max <= 0)
+    return result;
+
+  /* |G|^2 = h^T M h with M = R^T R; the rows of R give |G|^2 = sum_i R_ii^2 (h_i + sum_{j>i} R_ij/R_ii h_j)^2 */
+  const rmatrix_t<3, 3> metric = reciprocal.basis_matrix().transpose() * reciprocal.basis_matrix();
+  const rmatrix_t<3, 3> r = metric.llt().matrixU();
+
+  /* points on the sphere itself are kept */
+  const real_t r2 = g_max * g_max * (1 + k_Tolerance);
+
+  const sint_t l_max = static_cast<sint_t>(std::floor(std::sqrt(r2) / r(2, 2)));
+  for(sint_t l = -l_max; l <= l_max; ++l) {
+    const real_t q2 = r(2, 2) * l;
+    const real_t rem2 = r2 - q2 * q2;
+    if(rem2 < 0)
+      continue;
+
+    const real_t c1 = -r(1, 2) * l / r(1, 1), w1 = std::sqrt(rem2) / r(1, 1);
+    for(sint_t k = static_cast<sint_t>(std::ceil(c1 - w1)); k <= static_cast<sint_t>(std::floor(c1 + w1)); ++k) {
+      const real_t q1 = r(1, 1) * k + r(1, 2) * l;
+      const real_t rem1 = rem2 - q1 * q1;
+      if(rem1 < 0)
+        continue;
+
+      const real_t c0 = -(r(0, 1) * k + r(0, 2) * l) / r(0, 0), w0 = std::sqrt(rem1) / r(0, 0);
+      for(sint_t h = static_cast<sint_t>(std::ceil(c0 - w0)); h <= static_cast<sint_t>(std::floor(c0 + w0)); ++h)
+        if(h != 0 || k != 0 || l != 0)
+          result.push_back(ivec3_t{h, k, l});
+    }
+  }
+
+  return result;
+}
+
+stl::vector<xrd::reflection_group> xrd::powder_reflections(const crystal& c, const ivector_t<3>& c_size, real_t wavelength, real_t theta_min,
+                                                           real_t theta_max) {
+  if(!(0 <= theta_min && theta_min <= theta_max && theta_max <= C_PI / 2))
+    throw std::invalid_argument(fmt::format("invalid Bragg angle range for the powder reflections: [{0}, {1}]", theta_min, theta_max));
+
+  const lattice reciprocal = c.lattice().reciprocal();
+  const real_t g_min = 4 * C_PI * std::sin(theta_min) / wavelength;
+  const real_t g_max = 4 * C_PI * std::sin(theta_max) / wavelength;
+
+  /* every order of a direction is in its single plane pattern, so only the distinct primitive directions are kept;
+   * directions whose orders are all systematically absent never show up */
+  stl::vector<ivec3_t> directions;
+  for(const ivec3_t& h : enumerate_reciprocal_vectors(reciprocal, g_max))
+    if(!c.is_absent(h) && reciprocal.r3_vector(h.cast<real_t>()).norm() >= g_min * (1 - k_Tolerance))
+      directions.push_back(primitive(h));
+
+  /* descending, so that the representatives have positive indices where possible */
+  std::sort(directions.begin(), directions.end(), [](const ivec3_t& a, const ivec3_t& b) {
+    return std::tie(a(0), a(1), a(2)) > std::tie(b(0), b(1), b(2));
+  });
+  directions.erase(std::unique(directions.begin(), directions.end()), directions.end());
+
+  /* operations that leave the metric and the crystallite invariant */
+  const rmatrix_t<3, 3> metric = reciprocal.basis_matrix().transpose() * reciprocal.basis_matrix();
+  const rvec3_t size = c_size.cast<real_t>();
+  stl::vector<permutation> operations;
+  for(const permutation& p : signed_permutations())
+    if((p.transpose() * metric * p - metric).norm() <= k_Tolerance * metric.norm() && (p.cwiseAbs() * size - size).isZero())
+      operations.push_back(p);
+
+  struct candidate {
+    ivec3_t plane;
+    real_t g_norm;
+    /* |F|^2 of the orders inside the range */
+    stl::vector<real_t> intensities;
+  };
+  stl::vector<candidate> candidates;
+  candidates.reserve(directions.size());
+  for(const ivec3_t& d : directions) {
+    const rvec3_t g = reciprocal.r3_vector(d.cast<real_t>());
+    const real_t g_norm = g.norm();
+
+    candidate cand{d, g_norm, {}};
+    const sint_t n_min = std::max<sint_t>(1, static_cast<sint_t>(std::ceil(g_min / g_norm * (1 - k_Tolerance))));
+    const sint_t n_max = static_cast<sint_t>(std::floor(g_max / g_norm * (1 + k_Tolerance)));
+    bool visible = false;
+    for(sint_t n = n_min; n <= n_max; ++n) {
+      cand.intensities.push_back(c.is_absent(ivec3_t(n * d)) ? 0 : math::squared_norm(c.structure_factor(real_t(n) * g)));
+      visible |= cand.intensities.back() > k_Tolerance;
+    }
+    /* directions whose orders in the range are all extinct contribute nothing */
+    if(visible)
+      candidates.push_back(std::move(cand));
+  }
+  std::stable_sort(candidates.begin(), candidates.end(), [](const candidate& a, const candidate& b) { return a.g_norm < b.g_norm; });
+
+  const auto same_intensities = [](const candidate& a, const candidate& b) {
+    if(a.intensities.size() != b.intensities.size())
+      return false;
+    for(size_t ii = 0; ii < a.intensities.size(); ++ii)
+      if(std::abs(a.intensities[ii] - b.intensities[ii]) > k_Tolerance * std::max<real_t>(1, std::max(a.intensities[ii], b.intensities[ii])))
+        return false;
+    return true;
+  };
+
+  stl::vector<reflection_group> result;
+  /* representatives of the groups of the current |G| shell, as indices into candidates */
+  stl::vector<size_t> shell;
+  for(size_t ii = 0; ii < candidates.size(); ++ii) {
+    const candidate& cand = candidates[ii];
+    if(shell.empty() || cand.g_norm > candidates[shell.front()].g_norm * (1 + k_Tolerance))
+      shell.clear();
+
+    const rvec3_t plane = cand.plane.cast<real_t>();
+    const auto group = std::find_if(shell.begin(), shell.end(), [&](size_t jj) {
+      const rvec3_t rep = candidates[jj].plane.cast<real_t>();
+      return same_intensities(candidates[jj], cand) &&
+             std::any_of(operations.begin(), operations.end(), [&](const permutation& p) { return (p * rep - plane).isZero(); });
+    });
+
+    if(group != shell.end()) {
+      /* the shell holds the groups of this shell in the same order as the end of result */
+      ++result[result.size() - shell.size() + (group - shell.begin())].multiplicity;
+    } else {
+      shell.push_back(ii);
+      result.push_back({cand.plane, 1, cand.g_norm});
+    }
+  }
+
+  return result;
+}
+
+bool xrd::is_extinct(const crystal& c, const rvec3_t& plane, real_t wavelength, real_t theta_min, real_t theta_max) {
+  if(!c.space_group())
+    return false;
+
+  const real_t g_norm = c.lattice().reciprocal().r3_vector(plane).norm();
+  const real_t g_min = 4 * C_PI * std::sin(theta_min) / wavelength;
+  const real_t g_max = 4 * C_PI * std::sin(theta_max) / wavelength;
+
+  /* a plane without orders in the range is left to the engines (its tails may still reach into it) */
+  bool any = false;
+  for(sint_t n = std::max<sint_t>(1, static_cast<sint_t>(std::ceil(g_min / g_norm))); n * g_norm <= g_max; ++n) {
+    if(!c.is_absent(rvec3_t(n * plane)))
+      return false;
+    any = true;
+  }
+  return any;
+}
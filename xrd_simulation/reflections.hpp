@@ -0,0 +1,42 @@
+#ifndef XRD_REFLECTIONS_HPP
+#define XRD_REFLECTIONS_HPP
+
+#include <types.hpp>
+
+#include "crystal.hpp"
+#include "lattice.hpp"
+
+namespace xrd {
+  /// Miller indices of every reciprocal lattice vector G = h a* + k b* + l c* with 0 < |G| <= g_max. The search is a
+  /// Fincke-Pohst walk: the range of each index follows from the indices already fixed, so only the points inside the
+  /// ellipsoid |G| <= g_max are visited rather than its bounding box.
+  stl::vector<ivec3_t> enumerate_reciprocal_vectors(const lattice& reciprocal, real_t g_max);
+
+  /// Lattice directions (primitive hkl) whose single plane patterns are identical, so that one of them can be
+  /// simulated with the others as its multiplicity.
+  struct reflection_group {
+    /// primitive Miller indices of the representative
+    ivec3_t plane;
+    uint_t multiplicity;
+    /// |G| of the representative, in 1/Angstrom (including the factor 2 pi)
+    real_t g_norm;
+  };
+
+  /// Reflection groups of a powder for Bragg angles theta_min <= theta <= theta_max (in radians).
+  ///
+  /// Reflections that are systematically absent in the space group of the crystal are skipped before anything is
+  /// evaluated. Every other reciprocal lattice vector in the range is reduced to its primitive direction, since the
+  /// single plane pattern of a direction contains all its orders. Two directions of equal |G| are merged when a signed
+  /// permutation of the axes maps one onto the other, preserves the lattice metric and the crystallite size along each
+  /// axis (so the mosaic and interference profiles are the same), and |F|^2 agrees at every order inside the range (so
+  /// the basis respects the operation). Equal-|G| directions that fail either test give different patterns and stay
+  /// separate.
+  /// Groups are sorted by |G|.
+  stl::vector<reflection_group> powder_reflections(const crystal& c, const ivector_t<3>& c_size, real_t wavelength, real_t theta_min, real_t theta_max);
+
+  /// Whether every order of plane with its Bragg angle in [theta_min, theta_max] (in radians) is systematically absent
+  /// (see crystal::is_absent()), so that its single plane pattern need not be evaluated.
+  [[nodiscard]] bool is_extinct(const crystal& c, const rvec3_t& plane, real_t wavelength, real_t theta_min, real_t theta_max);
+}    // namespace xrd
+
+#endif    //XRD_REFLECTIONS_HPP
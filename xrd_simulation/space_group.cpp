@@ -0,0 +1,272 @@
+#include "space_group.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include <nlohmann/json.hpp>
+
+#include <string.hpp>
+
+namespace {
+  using operation = xrd::space_group::operation;
+
+  constexpr sint_t k_Denominator = xrd::space_group::k_TranslationDenominator;
+
+  /* groups are closed by hand; no group has more than 192 operations */
+  constexpr size_t k_MaxOperations = 192;
+
+  /* fractional positions closer than this (after wrapping) are the same site */
+  constexpr real_t k_SiteTolerance = 1e-4;
+
+  struct group_entry {
+    int number;
+    std::string_view symbol;
+    /* generators in xyz notation, separated by ';' */
+    std::string_view generators;
+  };
+
+  /* generators of the International Tables, standard setting */
+  constexpr std::array<group_entry, 16> k_Groups{{
+    {1, "P1", ""},
+    {2, "P-1", "-x,-y,-z"},
+    {14, "P21/c", "-x,y+1/2,-z+1/2;-x,-y,-z"},
+    {62, "Pnma", "-x+1/2,-y,z+1/2;-x,y+1/2,-z;-x,-y,-z"},
+    {123, "P4/mmm", "-x,-y,z;-y,x,z;-x,y,-z;-x,-y,-z"},
+    {139, "I4/mmm", "-x,-y,z;-y,x,z;-x,y,-z;-x,-y,-z;x+1/2,y+1/2,z+1/2"},
+    {166, "R-3m", "-y,x-y,z;y,x,-z;-x,-y,-z;x+2/3,y+1/3,z+1/3;x+1/3,y+2/3,z+2/3"},
+    {191, "P6/mmm", "-y,x-y,z;-x,-y,z;y,x,-z;-x,-y,-z"},
+    {194, "P63/mmc", "-y,x-y,z;-x,-y,z+1/2;y,x,-z;-x,-y,-z"},
+    {216, "F-43m", "-x,-y,z;-x,y,-z;z,x,y;y,x,z;x,y+1/2,z+1/2;x+1/2,y,z+1/2;x+1/2,y+1/2,z"},
+    {221, "Pm-3m", "-x,-y,z;-x,y,-z;z,x,y;y,x,-z;-x,-y,-z"},
+    {223, "Pm-3n", "-x,-y,z;-x,y,-z;z,x,y;y+1/2,x+1/2,-z+1/2;-x,-y,-z"},
+    {225, "Fm-3m", "-x,-y,z;-x,y,-z;z,x,y;y,x,-z;-x,-y,-z;x,y+1/2,z+1/2;x+1/2,y,z+1/2;x+1/2,y+1/2,z"},
+    {227, "Fd-3m", "-x+3/4,-y+1/4,z+1/2;-x+1/4,y+1/2,-z+3/4;z,x,y;y+3/4,x+1/4,-z+1/2;-x,-y,-z;x,y+1/2,z+1/2;x+1/2,y,z+1/2;x+1/2,y+1/2,z"},
+    {229, "Im-3m", "-x,-y,z;-x,y,-z;z,x,y;y,x,-z;-x,-y,-z;x+1/2,y+1/2,z+1/2"},
+    {230, "Ia-3d", "-x+1/2,-y,z+1/2;-x,y+1/2,-z+1/2;z,x,y;y+3/4,x+1/4,-z+1/4;-x,-y,-z;x+1/2,y+1/2,z+1/2"},
+  }};
+
+  /* symbols are compared without spaces and underscores, so that "P 6_3/m m c" matches "P63/mmc" */
+  std::string normalise(std::string_view symbol) {
+    std::string result;
+    for(char c : symbol)
+      if(c != ' ' && c != '_')
+        result.push_back(c);
+    return result;
+  }
+
+  ivec3_t wrap(const ivec3_t& t) noexcept {
+    return t.unaryExpr([](sint_t x) { return ((x % k_Denominator) + k_Denominator) % k_Denominator; });
+  }
+
+  /* a after b */
+  operation compose(const operation& a, const operation& b) noexcept {
+    return {a.rotation * b.rotation, wrap(a.rotation * b.translation + a.translation)};
+  }
+
+  operation identity() noexcept {
+    return {matrix_t<sint_t, 3, 3>::Identity(), ivec3_t::Zero()};
+  }
+
+  /* closure of the generators under composition */
+  stl::vector<operation> generate_group(std::span<const operation> generators) {
+    stl::vector<operation> group{identity()};
+    for(const auto& g : generators)
+      if(std::find(group.begin(), group.end(), g) == group.end())
+        group.push_back(g);
+
+    for(size_t checked = 0; checked < group.size(); ++checked)
+      for(size_t jj = 0; jj <= checked; ++jj)
+        for(const operation& product : {compose(group[checked], group[jj]), compose(group[jj], group[checked])})
+          if(std::find(group.begin(), group.end(), product) == group.end()) {
+            if(group.size() == k_MaxOperations)
+              throw std::invalid_argument(fmt::format("operations generate more than {} operations: not a space group", k_MaxOperations));
+            group.push_back(product);
+          }
+
+    return group;
+  }
+
+  /* integer or fraction ("1/2", "0.25") in units of 1/k_Denominator */
+  sint_t parse_translation(std::string_view term, std::string_view xyz) {
+    real_t value;
+    if(const auto slash = term.find('/'); slash != std::string_view::npos) {
+      /* std::from_chars has no overload for sint_t when that is __int128 */
+      std::int64_t num = 0, den = 0;
+      std::from_chars(term.data(), term.data() + slash, num);
+      std::from_chars(term.data() + slash + 1, term.data() + term.size(), den);
+      if(den == 0)
+        throw std::invalid_argument(fmt::format("invalid translation in symmetry operation: {}", xyz));
+      value = real_t(num) / real_t(den);
+    } else {
+      value = std::stod(std::string(term));
+    }
+
+    const real_t scaled = value * k_Denominator;
+    if(std::abs(scaled - std::round(scaled)) > 1e-3)
+      throw std::invalid_argument(fmt::format("translation is not a multiple of 1/{} in symmetry operation: {}", k_Denominator, xyz));
+    return static_cast<sint_t>(std::round(scaled));
+  }
+}    // namespace
+
+xrd::space_group::space_group(std::string symbol, stl::vector<operation> operations) : m_Symbol{std::move(symbol)}, m_Operations{std::move(operations)} {
+  for(const auto& op : m_Operations)
+    if(!op.translation.isZero())
+      m_Conditions.push_back(op);
+}
+
+xrd::space_group xrd::space_group::from_symbol(std::string_view symbol) {
+  const std::string name = normalise(symbol);
+  for(const auto& entry : k_Groups)
+    if(name == entry.symbol || name == std::to_string(entry.number)) {
+      stl::vector<operation> generators;
+      for(const auto& op : string::view::tokenize(entry.generators, ";"))
+        generators.push_back(parse_operation(op));
+      return space_group(std::string(entry.symbol), generate_group(generators));
+    }
+
+  throw std::invalid_argument(fmt::format("space group not in the built-in table: {} (give its operations instead)", symbol));
+}
+
+xrd::space_group xrd::space_group::from_operations(std::string symbol, std::span<const std::string> operations) {
+  stl::vector<operation> generators;
+  generators.reserve(operations.size());
+  for(const auto& op : operations)
+    generators.push_back(parse_operation(op));
+  return space_group(std::move(symbol), generate_group(generators));
+}
+
+auto xrd::space_group::parse_operation(std::string_view xyz) -> operation {
+  const auto components = string::view::tokenize(xyz, ",");
+  if(components.size() != 3)
+    throw std::invalid_argument(fmt::format("symmetry operation must have three components: {}", xyz));
+
+  operation op{matrix_t<sint_t, 3, 3>::Zero(), ivec3_t::Zero()};
+  for(sint_t ii = 0; ii < 3; ++ii) {
+    std::string component;
+    for(char c : components[ii])
+      if(!std::isspace(static_cast<unsigned char>(c)))
+        component.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+
+    /* terms are split at the signs: "-x+y+1/2" -> "-x", "+y", "+1/2" */
+    size_t begin = 0;
+    while(begin < component.size()) {
+      size_t end = component.find_first_of("+-", begin + 1);
+      if(end == std::string::npos)
+        end = component.size();
+      std::string_view term = std::string_view(component).substr(begin, end - begin);
+      begin = end;
+
+      sint_t sign = 1;
+      if(term.front() == '+' || term.front() == '-') {
+        sign = (term.front() == '-') ? -1 : 1;
+        term.remove_prefix(1);
+      }
+      if(term.empty())
+        throw std::invalid_argument(fmt::format("malformed symmetry operation: {}", xyz));
+
+      if(term == "x" || term == "y" || term == "z")
+        op.rotation(ii, term.front() - 'x') += sign;
+      else
+        op.translation(ii) += sign * parse_translation(term, xyz);
+    }
+  }
+
+  if(std::abs(op.rotation.cast<real_t>().determinant()) != 1)
+    throw std::invalid_argument(fmt::format("symmetry operation is not invertible on the lattice: {}", xyz));
+  op.translation = wrap(op.translation);
+  return op;
+}
+
+std::string xrd::space_group::to_xyz(const operation& op) {
+  std::string result;
+  for(sint_t ii = 0; ii < 3; ++ii) {
+    std::string component;
+    for(sint_t jj = 0; jj < 3; ++jj)
+      if(op.rotation(ii, jj) != 0) {
+        if(op.rotation(ii, jj) < 0)
+          component += '-';
+        else if(!component.empty())
+          component += '+';
+        component += static_cast<char>('x' + jj);
+      }
+    if(const sint_t t = op.translation(ii); t != 0) {
+      const sint_t g = std::gcd(t, k_Denominator);
+      component += fmt::format("+{}/{}", t / g, k_Denominator / g);
+    }
+    result += (ii == 0) ? component : ("," + component);
+  }
+  return result;
+}
+
+void xrd::space_group::validate(const lattice& l) const {
+  /* R maps the lattice onto itself when it preserves the metric, R^T G R = G */
+  const rmatrix_t<3, 3> metric = l.basis_matrix().transpose() * l.basis_matrix();
+  for(const auto& op : m_Operations) {
+    const rmatrix_t<3, 3> r = op.rotation.cast<real_t>();
+    if((r.transpose() * metric * r - metric).norm() > 1e-6 * metric.norm())
+      throw std::invalid_argument(fmt::format("space group {} does not match the lattice (operation {}); the conventional cell is required", m_Symbol,
+                                              to_xyz(op)));
+  }
+}
+
+stl::vector<rvec3_t> xrd::space_group::orbit(const rvec3_t& r) const {
+  stl::vector<rvec3_t> images;
+  for(const auto& op : m_Operations) {
+    rvec3_t image = op.apply(r);
+    image = image.array() - image.array().floor();
+
+    const bool known = std::any_of(images.begin(), images.end(), [&image](const rvec3_t& other) {
+      const rvec3_t d = image - other;
+      return (d.array() - d.array().round()).abs().maxCoeff() < k_SiteTolerance;
+    });
+    if(!known)
+      images.push_back(image);
+  }
+  return images;
+}
+
+xrd::basis xrd::space_group::expand(const basis& asymmetric_unit) const {
+  stl::vector<basis::atom> atoms;
+  for(const auto& atom : asymmetric_unit)
+    for(const rvec3_t& r : orbit(atom.r)) {
+      const bool known = std::any_of(atoms.begin(), atoms.end(), [&](const basis::atom& other) {
+        const rvec3_t d = r - other.r;
+        return other.f == atom.f && (d.array() - d.array().round()).abs().maxCoeff() < k_SiteTolerance;
+      });
+      if(!known)
+        atoms.push_back({atom.f, atom.m, r});
+    }
+  return basis(atoms);
+}
+
+bool xrd::space_group::is_absent(const ivec3_t& hkl) const noexcept {
+  for(const auto& op : m_Conditions)
+    if((op.rotation.transpose() * hkl - hkl).isZero() && hkl.dot(op.translation) % k_Denominator != 0)
+      return true;
+  return false;
+}
+
+xrd::space_group nlohmann::adl_serializer<xrd::space_group>::from_json(const json& j) {
+  if(j.is_string())
+    return xrd::space_group::from_symbol(j.get<std::string>());
+  if(j.is_number_integer())
+    return xrd::space_group::from_symbol(std::to_string(j.get<int>()));
+
+  if(!j.contains("operations"))
+    return xrd::space_group::from_symbol(j.at("symbol").get<std::string>());
+  const std::string symbol = j.contains("symbol") ? j.at("symbol").get<std::string>() : "";
+  return xrd::space_group::from_operations(symbol, j.at("operations").get<stl::vector<std::string>>());
+}
+
+void nlohmann::adl_serializer<xrd::space_group>::to_json(json& j, const xrd::space_group& g) {
+  j["symbol"] = g.symbol();
+  for(const auto& op : g.operations())
+    j["operations"].push_back(xrd::space_group::to_xyz(op));
+}
@@ -0,0 +1,90 @@
+#ifndef XRD_SPACE_GROUP_HPP
+#define XRD_SPACE_GROUP_HPP
+
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <nlohmann/json_fwd.hpp>
+
+#include <types.hpp>
+
+#include "basis.hpp"
+#include "lattice.hpp"
+
+namespace xrd {
+  /// Symmetry operations x' = R x + t of a space group, in fractional coordinates of its conventional cell.
+  class space_group {
+   public:
+    /// Translations are kept exactly, in units of 1/k_TranslationDenominator (every translation of the International
+    /// Tables is a multiple of 1/12).
+    static constexpr sint_t k_TranslationDenominator = 12;
+
+    struct operation {
+      matrix_t<sint_t, 3, 3> rotation;
+      /// in [0, k_TranslationDenominator)
+      ivec3_t translation;
+
+      [[nodiscard]] rvec3_t apply(const rvec3_t& r) const noexcept {
+        return rotation.cast<real_t>() * r + translation.cast<real_t>() / k_TranslationDenominator;
+      }
+
+      [[nodiscard]] bool operator==(const operation& other) const noexcept {
+        return rotation == other.rotation && translation == other.translation;
+      }
+    };
+
+    /// Group of a Hermann-Mauguin symbol ("Fm-3m", "F m -3 m", "P6_3/mmc") or International Tables number ("225"), in the
+    /// standard setting (origin choice 2 and hexagonal axes where there is a choice). Only a table of common groups is
+    /// built in; any other group can be given by its operations. Throws std::invalid_argument for unknown symbols.
+    static space_group from_symbol(std::string_view symbol);
+    /// Group generated by the given operations in xyz notation ("-y,x+1/2,z"); the identity is implied, and the list may be
+    /// the full group (as in a CIF file) or just its generators.
+    static space_group from_operations(std::string symbol, std::span<const std::string> operations);
+
+    /// Parses one operation in xyz notation. Throws std::invalid_argument on malformed input.
+    static operation parse_operation(std::string_view xyz);
+    /// Inverse of parse_operation().
+    static std::string to_xyz(const operation& op);
+
+    [[nodiscard]] inline const std::string& symbol() const noexcept {
+      return m_Symbol;
+    }
+    [[nodiscard]] inline std::span<const operation> operations() const noexcept {
+      return m_Operations;
+    }
+
+    /// Throws std::invalid_argument if an operation does not map the lattice onto itself (e.g. a primitive cell was given
+    /// for a centred group).
+    void validate(const lattice& l) const;
+
+    /// Distinct images of a fractional position, wrapped into [0, 1).
+    [[nodiscard]] stl::vector<rvec3_t> orbit(const rvec3_t& r) const;
+    /// Basis of the full cell from the atoms of the asymmetric unit (each atom is replaced by its orbit). Atoms of the same
+    /// element on the same site are only kept once, so expanding a full cell again leaves it unchanged.
+    [[nodiscard]] basis expand(const basis& asymmetric_unit) const;
+
+    /// Whether every crystal with this space group has F(hkl) = 0: some operation (R, t) leaves hkl invariant (hkl R = hkl)
+    /// while its translation gives the phase 2 pi hkl . t != 0 mod 2 pi. Covers the integral (centring), zonal (glide) and
+    /// serial (screw) conditions; extinctions due to special positions are not included.
+    [[nodiscard]] bool is_absent(const ivec3_t& hkl) const noexcept;
+
+   private:
+    space_group(std::string symbol, stl::vector<operation> operations);
+
+    std::string m_Symbol;
+    stl::vector<operation> m_Operations;
+    /// operations with a non-zero translation, the only ones that can extinguish reflections
+    stl::vector<operation> m_Conditions;
+  };
+}    // namespace xrd
+
+namespace nlohmann {
+  template <>
+  struct adl_serializer<xrd::space_group> {
+    static xrd::space_group from_json(const json& j);
+    static void to_json(json& j, const xrd::space_group& g);
+  };
+}    // namespace nlohmann
+
+#endif    //XRD_SPACE_GROUP_HPP
@@ -0,0 +1,25 @@
+#include "elements.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+uint_t xrd::tables::atomic_number(std::string_view symbol) {
+  /* one letter, optionally followed by a second one; compared case-insensitively ("FE1", "CL1"), so the symbol is
+   * normalised to an upper case letter followed by a lower case one */
+  std::array<char, 2> normalised{};
+  size_t length = 0;
+  for(; length < std::min<size_t>(symbol.size(), 2) && std::isalpha(static_cast<unsigned char>(symbol[length])); ++length)
+    normalised[length] = static_cast<char>((length == 0) ? std::toupper(static_cast<unsigned char>(symbol[length]))
+                                                          : std::tolower(static_cast<unsigned char>(symbol[length])));
+
+  /* labels such as "Oa" fall back to the one letter symbol */
+  for(; length > 0; --length)
+    for(uint_t ii = 0; ii < details::k_Elements.size(); ++ii)
+      if(details::k_Elements[ii].symbol == std::string_view(normalised.data(), length))
+        return ii + 1;
+
+  throw std::invalid_argument(fmt::format("unrecognized element symbol: {}", symbol));
+}